@@ -0,0 +1,256 @@
+#define _DEFAULT_SOURCE
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Арены: память для разбора и исполнения строки берётся блоками через
+// mmap и освобождается целиком. Блоки не дробят кучу malloc, а
+// освободившиеся блоки копятся в пуле и в простое отдаются ОС через
+// madvise, поэтому долго работающий shell не раздувает адресное
+// пространство, которое копирует каждый fork.
+//
+// Первый блок арены - одна страница, следующие вдвое больше, до
+// ARENA_BLOCK_SIZE: дереву из кэша разбора хватает страницы, а
+// строковая арена быстро выходит на крупные блоки и берёт их из пула.
+
+#define ARENA_BLOCK_SIZE (64 * 1024)            // Наибольший обычный блок
+#define ARENA_TRIM_THRESHOLD (1024 * 1024)      // Байт в пуле до madvise
+#define ARENA_ALIGN 16
+#define ARENA_POOL_MAX 64
+#define ARENA_POOL_BIG_MAX (4 * 1024 * 1024)   // Крупнее в пул не берём
+
+#define ALIGN_UP(n, a) (((n) + (a) - 1) & ~((size_t)(a) - 1))
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;         // Размер отображения
+    size_t used;         // Занято от начала блока, включая заголовок
+    int trimmed;         // Страницы данных уже отданы ОС
+} arena_block_t;
+
+struct arena {
+    arena_block_t *head;     // Текущий блок (остальные - по next)
+    arena_block_t *first;    // Блок, в котором лежит сама арена
+    void *last;              // Последнее выделение (для arena_realloc)
+    size_t next_size;        // Размер следующего блока
+};
+
+#define BLOCK_HEADER ALIGN_UP(sizeof(arena_block_t), ARENA_ALIGN)
+
+arena_t *line_arena = NULL;
+
+static arena_block_t *pool = NULL;   // Свободные блоки
+static int pool_count = 0;
+static size_t pool_untrimmed = 0;    // Байт пула, которые может вернуть arena_trim
+static arena_stats_t stats;
+
+static size_t page_size(void) {
+    static size_t cached = 0;
+    if (cached == 0) {
+        long size = sysconf(_SC_PAGESIZE);
+        cached = size > 0 ? (size_t)size : 4096;
+    }
+    return cached;
+}
+
+// Страницы блока после первой: их отдаёт ОС arena_trim
+static size_t trimmable(const arena_block_t *block) {
+    return block->trimmed ? 0 : block->size - page_size();
+}
+
+static arena_block_t *block_get(size_t min_payload, size_t size) {
+    if (min_payload + BLOCK_HEADER > size) {
+        size = ALIGN_UP(min_payload + BLOCK_HEADER, page_size());
+    }
+
+    // Наименьший подходящий блок из пула: страничный блок не занимает
+    // крупный, а длинные строки повторно получают свои крупные блоки
+    arena_block_t **best = NULL;
+    for (arena_block_t **link = &pool; *link != NULL; link = &(*link)->next) {
+        if ((*link)->size >= size && (best == NULL || (*link)->size < (*best)->size)) {
+            best = link;
+        }
+    }
+
+    arena_block_t *block = NULL;
+    if (best != NULL) {
+        block = *best;
+        *best = block->next;
+        pool_count--;
+        pool_untrimmed -= trimmable(block);
+    }
+
+    if (block == NULL) {
+        void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            perror("mmap");
+            return NULL;
+        }
+        block = mem;
+        block->size = size;
+        stats.blocks_mapped++;
+        stats.bytes_mapped += size;
+    }
+
+    block->next = NULL;
+    block->used = BLOCK_HEADER;
+    block->trimmed = 0;
+    return block;
+}
+
+static void block_put(arena_block_t *block) {
+    if (block->size > ARENA_POOL_BIG_MAX || pool_count >= ARENA_POOL_MAX) {
+        stats.blocks_mapped--;
+        stats.bytes_mapped -= block->size;
+        munmap(block, block->size);
+        return;
+    }
+
+    block->next = pool;
+    pool = block;
+    pool_count++;
+    pool_untrimmed += trimmable(block);
+}
+
+arena_t *arena_create(void) {
+    arena_block_t *block = block_get(sizeof(arena_t), page_size());
+    if (block == NULL) {
+        return NULL;
+    }
+
+    arena_t *arena = (arena_t *)((char *)block + block->used);
+    block->used += ALIGN_UP(sizeof(arena_t), ARENA_ALIGN);
+    arena->head = block;
+    arena->first = block;
+    arena->last = NULL;
+    arena->next_size = page_size() * 2;
+    return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    size = ALIGN_UP(size > 0 ? size : 1, ARENA_ALIGN);
+    arena_block_t *block = arena->head;
+
+    if (block->used + size > block->size) {
+        block = block_get(size, arena->next_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->head;
+        arena->head = block;
+        if (arena->next_size < ARENA_BLOCK_SIZE) {
+            arena->next_size *= 2;
+        }
+    }
+
+    void *ptr = (char *)block + block->used;
+    block->used += size;
+    arena->last = ptr;
+    stats.bytes_allocated += size;
+    return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t size) {
+    void *ptr = arena_alloc(arena, size);
+    if (ptr != NULL) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+// Увеличение ранее выделенного куска. Последнее выделение растёт на
+// месте, если в блоке хватает места, иначе данные копируются.
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (ptr == NULL) {
+        return arena_alloc(arena, new_size);
+    }
+
+    arena_block_t *block = arena->head;
+    size_t old_aligned = ALIGN_UP(old_size > 0 ? old_size : 1, ARENA_ALIGN);
+    size_t new_aligned = ALIGN_UP(new_size, ARENA_ALIGN);
+
+    if (ptr == arena->last &&
+        (char *)ptr + old_aligned == (char *)block + block->used &&
+        block->used - old_aligned + new_aligned <= block->size) {
+        if (new_aligned > old_aligned) {
+            stats.bytes_allocated += new_aligned - old_aligned;
+        }
+        block->used = block->used - old_aligned + new_aligned;
+        return ptr;
+    }
+
+    void *grown = arena_alloc(arena, new_size);
+    if (grown != NULL) {
+        memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return grown;
+}
+
+char *arena_strndup(arena_t *arena, const char *s, size_t n) {
+    char *copy = arena_alloc(arena, n + 1);
+    if (copy != NULL) {
+        memcpy(copy, s, n);
+        copy[n] = '\0';
+    }
+    return copy;
+}
+
+char *arena_strdup(arena_t *arena, const char *s) {
+    return arena_strndup(arena, s, strlen(s));
+}
+
+// Сброс арены одной операцией: все блоки, кроме первого, уходят в пул
+void arena_reset(arena_t *arena) {
+    arena_block_t *block = arena->head;
+    while (block != arena->first) {
+        arena_block_t *next = block->next;
+        block_put(block);
+        block = next;
+    }
+
+    arena->head = arena->first;
+    arena->first->used = (char *)arena - (char *)arena->first +
+                         ALIGN_UP(sizeof(arena_t), ARENA_ALIGN);
+    arena->last = NULL;
+}
+
+void arena_destroy(arena_t *arena) {
+    if (arena == NULL) return;
+
+    arena_block_t *block = arena->head;
+    while (block != NULL) {
+        arena_block_t *next = block->next;
+        block_put(block);
+        block = next;
+    }
+}
+
+// Вызывается в простое: страницы свободных блоков отдаются ОС, когда
+// их набралось больше ARENA_TRIM_THRESHOLD, - обычная строка берёт из
+// пула те же блоки, и madvise на каждом приглашении только заставлял бы
+// их заново обнулять страницы. Заголовок блока остаётся на первой
+// странице, отображение сохраняется для повторного использования без mmap.
+void arena_trim(void) {
+    if (pool_untrimmed < ARENA_TRIM_THRESHOLD) {
+        return;
+    }
+
+    size_t page = page_size();
+    for (arena_block_t *block = pool; block != NULL; block = block->next) {
+        if (!block->trimmed && block->size > page) {
+            madvise((char *)block + page, block->size - page, MADV_DONTNEED);
+            block->trimmed = 1;
+            stats.trims++;
+        }
+    }
+    pool_untrimmed = 0;
+}
+
+void get_arena_stats(arena_stats_t *out) {
+    *out = stats;
+    out->pool_blocks = pool_count;
+}
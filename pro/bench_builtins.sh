@@ -0,0 +1,39 @@
+#!/bin/sh
+# Бенчмарк встроенных echo/printf/true/false/pwd/test/[.
+# Один и тот же сценарий выполняется дважды: с отключёнными командами
+# (enable -n, каждая строка запускает внешнюю программу) и с
+# включёнными. Число запусков берётся из launchstat.
+#
+# Использование: ./bench_builtins.sh [число повторов]
+
+SHELL_BIN=${SHELL_BIN:-./shell}
+ROUNDS=${1:-200}
+SCRIPT=$(mktemp)
+OUT=$(mktemp)
+trap 'rm -f "$SCRIPT" "$OUT"' EXIT
+
+make_script() {
+    [ -n "$1" ] && echo "enable -n echo printf true false pwd test ["
+    echo "launchstat -r"
+    i=0
+    while [ $i -lt "$ROUNDS" ]; do
+        echo "[ -d /tmp ] && echo dir $i"
+        echo "test -e /etc/passwd -a -r /etc/passwd && printf '%s %d\\n' passwd $i"
+        echo "true && false || pwd"
+        i=$((i + 1))
+    done
+    echo "launchstat"
+}
+
+run() {
+    make_script "$2" > "$SCRIPT"
+    start=$(date +%s%N)
+    "$SHELL_BIN" < "$SCRIPT" > "$OUT" 2>/dev/null
+    end=$(date +%s%N)
+    launches=$(grep -E '^ +(posix_spawn|fork) ' "$OUT" | awk '{ n += $2 } END { print n + 0 }')
+    printf '%-10s %6d lines  %6d launches  %6d ms\n' "$1" $((ROUNDS * 3)) "$launches" \
+        $(((end - start) / 1000000))
+}
+
+run external disable
+run builtin
@@ -0,0 +1,301 @@
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Микробенчмарк парсера: прогоняет корпус типичных строк через лексер
+// и parse_line и считает время, пропускную способность, аллокации
+// malloc и байты, выданные аренами.
+//
+// Использование: ./bench_parser [--json ФАЙЛ] [--min-time СЕКУНДЫ]
+// Таблица всегда выводится на stdout, --json дополнительно пишет
+// результаты в файл для сравнения прогонов.
+
+// Подсчёт аллокаций: malloc и компания перехватываются целиком
+// (в том числе вызовы изнутри libc, например из strdup)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long alloc_calls = 0;
+static unsigned long alloc_bytes = 0;
+
+void *malloc(size_t size) {
+    alloc_calls++;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    alloc_calls++;
+    alloc_bytes += nmemb * size;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    alloc_calls++;
+    alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+// Динамическая строка для построения корпуса
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} buffer_t;
+
+static void buf_append(buffer_t *b, const char *s) {
+    size_t n = strlen(s);
+    if (b->len + n + 1 > b->cap) {
+        b->cap = (b->len + n + 1) * 2;
+        b->data = realloc(b->data, b->cap);
+        if (b->data == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memcpy(b->data + b->len, s, n + 1);
+    b->len += n;
+}
+
+typedef struct {
+    const char *name;
+    char *line;
+} corpus_case_t;
+
+typedef struct {
+    const char *name;
+    const char *stage;
+    size_t line_len;
+    unsigned long iterations;
+    double ns_per_line;
+    double bytes_per_sec;
+    double mallocs_per_line;
+    double malloc_bytes_per_line;
+    double arena_bytes_per_line;
+} result_t;
+
+static char *make_args_line(int count) {
+    buffer_t b = {0};
+    char word[32];
+    buf_append(&b, "ls -l");
+    for (int i = 0; i < count; i++) {
+        snprintf(word, sizeof(word), " file_%05d.txt", i);
+        buf_append(&b, word);
+    }
+    return b.data;
+}
+
+static char *make_and_chain(int depth) {
+    buffer_t b = {0};
+    for (int i = 0; i < depth; i++) {
+        buf_append(&b, i % 2 ? "test -d /tmp && " : "true || ");
+    }
+    buf_append(&b, "echo done");
+    return b.data;
+}
+
+static char *make_redirections(int count) {
+    buffer_t b = {0};
+    char word[112];
+    for (int i = 0; i < count; i++) {
+        snprintf(word, sizeof(word), "%ssort -u < in_%d.txt > out_%d.txt 2>> err_%d.log 2>&1",
+                 i > 0 ? " ; " : "", i, i, i);
+        buf_append(&b, word);
+    }
+    return b.data;
+}
+
+static char *make_quoted(int count) {
+    buffer_t b = {0};
+    static const char *parts[] = {
+        " \"hello world\"", " 'single $quoted'", " escaped\\ space",
+        " \"a|b&&c;d\"", " mix\"ed q\"uo'te's", " \\\"lit\\\""
+    };
+    buf_append(&b, "printf");
+    for (int i = 0; i < count; i++) {
+        buf_append(&b, parts[i % 6]);
+    }
+    return b.data;
+}
+
+static char *make_pipeline(int stages) {
+    buffer_t b = {0};
+    buf_append(&b, "cat access.log");
+    for (int i = 0; i < stages; i++) {
+        buf_append(&b, i % 2 ? " | grep -v 404" : " | cut -d' ' -f1");
+    }
+    return b.data;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+enum { STAGE_TOKENIZE, STAGE_PARSE, STAGE_CACHED };
+
+static void run_once(int stage, const char *line) {
+    switch (stage) {
+        case STAGE_TOKENIZE:
+            tokenize(line, line_arena);
+            break;
+        case STAGE_PARSE:
+            free_command_list(parse_line(line));
+            break;
+        case STAGE_CACHED:
+            release_command_list(parse_line_cached(line));
+            break;
+    }
+    // Как в main: временная память строки сбрасывается после каждой строки
+    arena_reset(line_arena);
+}
+
+static result_t bench_case(const corpus_case_t *c, int stage, double min_time_ns) {
+    static const char *stage_names[] = {"tokenize", "parse_line", "parse_cached"};
+    result_t r;
+    r.name = c->name;
+    r.stage = stage_names[stage];
+    r.line_len = strlen(c->line);
+
+    // Прогрев (для кэша - заполнение)
+    run_once(stage, c->line);
+
+    unsigned long iterations = 0;
+    unsigned long batch = 1;
+    unsigned long calls_before = alloc_calls;
+    unsigned long bytes_before = alloc_bytes;
+    arena_stats_t arena_before;
+    get_arena_stats(&arena_before);
+    double start = now_ns();
+    double elapsed = 0;
+
+    while (elapsed < min_time_ns) {
+        for (unsigned long i = 0; i < batch; i++) {
+            run_once(stage, c->line);
+        }
+        iterations += batch;
+        batch *= 2;
+        elapsed = now_ns() - start;
+    }
+
+    r.iterations = iterations;
+    r.ns_per_line = elapsed / iterations;
+    r.bytes_per_sec = r.line_len * (double)iterations / (elapsed / 1e9);
+    r.mallocs_per_line = (double)(alloc_calls - calls_before) / iterations;
+    r.malloc_bytes_per_line = (double)(alloc_bytes - bytes_before) / iterations;
+
+    arena_stats_t arena_after;
+    get_arena_stats(&arena_after);
+    r.arena_bytes_per_line =
+        (double)(arena_after.bytes_allocated - arena_before.bytes_allocated) / iterations;
+    return r;
+}
+
+static void print_table(const result_t *results, int count) {
+    printf("word scan: %s\n", scan_word_run_name());
+    printf("%-12s %-13s %9s %12s %12s %10s %14s %14s\n",
+           "case", "stage", "bytes", "ns/line", "MB/s", "mallocs", "malloc bytes", "arena bytes");
+    for (int i = 0; i < count; i++) {
+        const result_t *r = &results[i];
+        printf("%-12s %-13s %9zu %12.0f %12.1f %10.1f %14.0f %14.0f\n",
+               r->name, r->stage, r->line_len, r->ns_per_line,
+               r->bytes_per_sec / 1e6, r->mallocs_per_line, r->malloc_bytes_per_line,
+               r->arena_bytes_per_line);
+    }
+}
+
+static void print_json(FILE *out, const result_t *results, int count) {
+    fprintf(out, "{\"benchmark\": \"parser\", \"word_scan\": \"%s\", \"results\": [\n",
+            scan_word_run_name());
+    for (int i = 0; i < count; i++) {
+        const result_t *r = &results[i];
+        fprintf(out, "  {\"case\": \"%s\", \"stage\": \"%s\", \"line_bytes\": %zu, "
+                "\"iterations\": %lu, \"ns_per_line\": %.1f, \"bytes_per_sec\": %.0f, "
+                "\"mallocs_per_line\": %.2f, \"malloc_bytes_per_line\": %.1f, "
+                "\"arena_bytes_per_line\": %.1f}%s\n",
+                r->name, r->stage, r->line_len, r->iterations, r->ns_per_line,
+                r->bytes_per_sec, r->mallocs_per_line, r->malloc_bytes_per_line,
+                r->arena_bytes_per_line,
+                i < count - 1 ? "," : "");
+    }
+    fprintf(out, "]}\n");
+}
+
+int main(int argc, char **argv) {
+    const char *json_file = NULL;
+    double min_time = 0.2;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_file = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--json FILE] [--min-time SECONDS]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    line_arena = arena_create();
+    if (line_arena == NULL) {
+        return 1;
+    }
+
+    corpus_case_t corpus[] = {
+        {"short", strdup("ls -la /tmp")},
+        {"typical", strdup("grep -rn \"TODO\" src | sort | uniq -c > todo.txt 2>&1")},
+        {"args_10k", make_args_line(10000)},
+        {"and_chain", make_and_chain(1000)},
+        {"redirs", make_redirections(300)},
+        {"quoting", make_quoted(2000)},
+        {"pipeline", make_pipeline(500)},
+    };
+    int corpus_size = sizeof(corpus) / sizeof(corpus[0]);
+    int stages[] = {STAGE_TOKENIZE, STAGE_PARSE, STAGE_CACHED};
+    int stage_count = sizeof(stages) / sizeof(stages[0]);
+
+    result_t *results = malloc(corpus_size * stage_count * sizeof(result_t));
+    if (results == NULL) {
+        perror("malloc");
+        return 1;
+    }
+
+    int n = 0;
+    for (int i = 0; i < corpus_size; i++) {
+        for (int s = 0; s < stage_count; s++) {
+            results[n++] = bench_case(&corpus[i], stages[s], min_time * 1e9);
+        }
+    }
+
+    print_table(results, n);
+
+    int status = 0;
+    if (json_file != NULL) {
+        FILE *out = fopen(json_file, "w");
+        if (out == NULL) {
+            perror(json_file);
+            status = 1;
+        } else {
+            print_json(out, results, n);
+            if (fclose(out) != 0) {
+                perror(json_file);
+                status = 1;
+            }
+        }
+    }
+
+    for (int i = 0; i < corpus_size; i++) {
+        free(corpus[i].line);
+    }
+    free(results);
+    return status;
+}
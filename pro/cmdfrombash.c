@@ -1,4 +1,7 @@
 #include "shell.h"
+#include <time.h>
+#include <sys/vfs.h>
+#include <dlfcn.h>
 
 extern history_t *global_history;
 
@@ -25,16 +28,23 @@ int from_bash_exit(char **args) {
     if (args[1] != NULL) {
         exit_code = atoi(args[1]);
     }
-    
+
+    // Дочерний shell завершается через _exit: exit вернул бы общую с
+    // родителем позицию stdin к своему буферу
+    if (in_subshell) {
+        fflush(stdout);
+        fflush(stderr);
+        _exit(exit_code);
+    }
     exit(exit_code);
 }
 
 int from_path(char **args) {
     char *path = getenv("PATH");
     if (path == NULL) {
-        printf("PATH is not set\n");
+        fprintf(builtin_out(), "PATH is not set\n");
     } else {
-        printf("PATH=%s\n", path);
+        fprintf(builtin_out(), "PATH=%s\n", path);
     }
     return 0;
 }
@@ -57,6 +67,7 @@ int set_path(char **args) {
         return 1;
     }
     
+    path_hash_clear();
     printf("PATH set to: %s\n", args[1]);
     return 0;
 }
@@ -95,6 +106,7 @@ int add_to_path(char **args) {
         free(new_path);
     }
     
+    path_hash_clear();
     printf("Added '%s' to PATH\n", args[1]);
     printf("New PATH: %s\n", getenv("PATH"));
     return 0;
@@ -108,10 +120,225 @@ int reset_path(char **args) {
         return 1;
     }
     
+    path_hash_clear();
     printf("PATH reset to default: %s\n", default_path);
     return 0;
 }
 
+// Сведения о каталоге PATH для pathprof
+typedef struct {
+    const char *dir;
+    double stat_us;          // Время stat() каталога
+    int exists;
+    int duplicate;           // Номер первого вхождения того же каталога или -1
+    int slow;                // Сетевая или пользовательская ФС
+    const char *fs;
+    unsigned long hits;      // Команд найдено в каталоге
+    dev_t dev;
+    ino_t ino;
+} path_dir_info_t;
+
+// Имя файловой системы по магическому числу statfs
+static const char *fs_type_name(long type, int *slow) {
+    *slow = 0;
+    switch ((unsigned long)type) {
+        case 0x01021997: *slow = 1; return "9p";
+        case 0x65735546: *slow = 1; return "fuse";
+        case 0x6969:     *slow = 1; return "nfs";
+        case 0xFF534D42: *slow = 1; return "cifs";
+        case 0xFE534D42: *slow = 1; return "smb2";
+        case 0x517B:     *slow = 1; return "smb";
+        case 0xEF53:     return "ext4";
+        case 0x01021994: return "tmpfs";
+        case 0x794C7630: return "overlay";
+        case 0x9123683E: return "btrfs";
+        case 0x58465342: return "xfs";
+        case 0x2FC12FC1: return "zfs";
+        default:         return "other";
+    }
+}
+
+static double elapsed_us(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e6 + (end.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+// Каталог остаётся в PATH после чистки
+static int path_dir_useful(const path_dir_info_t *d) {
+    return d->exists && d->duplicate < 0;
+}
+
+static char *join_path_dirs(path_dir_info_t *dirs, int count, const int *order) {
+    size_t total = 1;
+    for (int i = 0; i < count; i++) {
+        total += strlen(dirs[i].dir) + 1;
+    }
+
+    char *joined = arena_alloc(line_arena, total);
+    if (joined == NULL) {
+        return NULL;
+    }
+    char *out = joined;
+    for (int i = 0; i < count; i++) {
+        const path_dir_info_t *d = &dirs[order[i]];
+        if (!path_dir_useful(d)) {
+            continue;
+        }
+        if (out != joined) {
+            *out++ = ':';
+        }
+        size_t len = strlen(d->dir);
+        memcpy(out, d->dir, len);
+        out += len;
+    }
+    *out = '\0';
+    return joined;
+}
+
+// Профиль PATH: pathprof [-w]
+// Для каждого каталога - время stat(), существование, дубликаты, тип ФС
+// и число найденных в нём команд. С -w PATH переписывается: мёртвые и
+// повторные каталоги удаляются, медленные (9p, FUSE, NFS, SMB) уходят в конец.
+int path_prof_builtin(char **args) {
+    int rewrite = 0;
+    if (args[1] != NULL && strcmp(args[1], "-w") == 0) {
+        rewrite = 1;
+    } else if (args[1] != NULL) {
+        fprintf(stderr, "pathprof: unknown option '%s'\n", args[1]);
+        fprintf(stderr, "Usage: pathprof [-w]\n");
+        return 1;
+    }
+
+    const char *path_env = getenv("PATH");
+    if (path_env == NULL) {
+        printf("PATH is not set\n");
+        return 1;
+    }
+
+    // Разбиваем копию PATH на каталоги
+    char *copy = arena_strdup(line_arena, path_env);
+    int max_dirs = 1;
+    for (const char *p = path_env; *p; p++) {
+        if (*p == ':') max_dirs++;
+    }
+    path_dir_info_t *dirs = arena_alloc(line_arena, max_dirs * sizeof(path_dir_info_t));
+    int *order = arena_alloc(line_arena, max_dirs * sizeof(int));
+    if (copy == NULL || dirs == NULL || order == NULL) {
+        return 1;
+    }
+
+    int count = 0;
+    for (char *dir = copy; dir != NULL; ) {
+        char *colon = strchr(dir, ':');
+        if (colon != NULL) {
+            *colon = '\0';
+        }
+
+        path_dir_info_t *d = &dirs[count];
+        d->dir = dir;
+        d->stat_us = 0;
+        d->exists = 0;
+        d->duplicate = -1;
+        d->slow = 0;
+        d->fs = "-";
+        d->hits = path_dir_hits(dir);
+
+        // Пустой элемент get_full_path пропускает, поэтому он бесполезен
+        if (dir[0] != '\0') {
+            struct stat st;
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            int rc = stat(dir, &st);
+            d->stat_us = elapsed_us(&start);
+
+            if (rc == 0 && S_ISDIR(st.st_mode)) {
+                d->exists = 1;
+                d->dev = st.st_dev;
+                d->ino = st.st_ino;
+
+                struct statfs fs;
+                if (statfs(dir, &fs) == 0) {
+                    d->fs = fs_type_name((long)fs.f_type, &d->slow);
+                }
+
+                // Повтор - тот же каталог, в том числе через символическую ссылку
+                for (int j = 0; j < count; j++) {
+                    if (dirs[j].exists && dirs[j].dev == d->dev && dirs[j].ino == d->ino) {
+                        d->duplicate = j;
+                        break;
+                    }
+                }
+            }
+        }
+
+        count++;
+        dir = colon != NULL ? colon + 1 : NULL;
+    }
+
+    printf("%3s %10s %-8s %8s  %s\n", "#", "stat us", "fs", "hits", "directory");
+    for (int i = 0; i < count; i++) {
+        const path_dir_info_t *d = &dirs[i];
+        printf("%3d %10.1f %-8s %8lu  %s", i + 1, d->stat_us, d->fs, d->hits,
+               d->dir[0] != '\0' ? d->dir : "(empty)");
+        if (!d->exists) {
+            printf("  [missing]");
+        } else if (d->duplicate >= 0) {
+            printf("  [duplicate of #%d]", d->duplicate + 1);
+        } else if (d->slow) {
+            printf("  [slow]");
+        }
+        printf("\n");
+    }
+
+    // Очистка: быстрые каталоги в прежнем порядке, затем медленные
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (!dirs[i].slow) order[n++] = i;
+    }
+    for (int i = 0; i < count; i++) {
+        if (dirs[i].slow) order[n++] = i;
+    }
+    char *pruned = join_path_dirs(dirs, count, order);
+
+    // Предлагаемый порядок: среди быстрых каталогов чаще используемые
+    // раньше (устойчивая сортировка вставками, медленные остаются в конце)
+    for (int i = 1; i < count; i++) {
+        int cur = order[i];
+        int j = i - 1;
+        while (j >= 0 && !dirs[cur].slow && !dirs[order[j]].slow &&
+               dirs[order[j]].hits < dirs[cur].hits) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = cur;
+    }
+    char *suggested = join_path_dirs(dirs, count, order);
+    if (pruned == NULL || suggested == NULL) {
+        return 1;
+    }
+
+    if (strcmp(suggested, pruned) != 0) {
+        printf("Suggested order by hits (may change which of same-named commands runs):\n");
+        printf("  %s\n", suggested);
+    }
+
+    if (!rewrite) {
+        if (strcmp(pruned, path_env) != 0) {
+            printf("Run 'pathprof -w' to set PATH to:\n  %s\n", pruned);
+        }
+        return 0;
+    }
+
+    if (setenv("PATH", pruned, 1) != 0) {
+        perror("pathprof");
+        return 1;
+    }
+    path_hash_clear();
+    printf("New PATH: %s\n", pruned);
+    return 0;
+}
+
 // Новая встроенная команда для просмотра истории
 int show_history(char **args) {
     extern history_t *global_history;  // Нужно будет сделать историю глобальной или передавать
@@ -141,26 +368,1093 @@ int show_history(char **args) {
     return 0;
 }
 
+// Статистика кэша разобранных строк: parsecache [-c]
+int parse_cache_builtin(char **args) {
+    if (args[1] != NULL && strcmp(args[1], "-c") == 0) {
+        parse_cache_clear();
+        printf("Parse cache cleared\n");
+        return 0;
+    } else if (args[1] != NULL) {
+        fprintf(stderr, "parsecache: unknown option '%s'\n", args[1]);
+        fprintf(stderr, "Usage: parsecache [-c]\n");
+        return 1;
+    }
+
+    parse_cache_stats_t st;
+    get_parse_cache_stats(&st);
+
+    unsigned long total = st.hits + st.misses;
+    printf("Parse cache: %d/%d entries\n", st.entries, st.capacity);
+    printf("  hits:      %lu\n", st.hits);
+    printf("  misses:    %lu\n", st.misses);
+    printf("  evictions: %lu\n", st.evictions);
+    printf("  hit rate:  %.1f%%\n", total > 0 ? 100.0 * st.hits / total : 0.0);
+    return 0;
+}
+
+// Опции shell: set [-o|+o имя]
+int set_builtin(char **args) {
+    if (args[1] == NULL || (args[2] == NULL && strcmp(args[1], "-o") == 0)) {
+        print_options();
+        return 0;
+    }
+
+    int value;
+    if (strcmp(args[1], "-o") == 0) {
+        value = 1;
+    } else if (strcmp(args[1], "+o") == 0) {
+        value = 0;
+    } else {
+        fprintf(stderr, "set: unknown option '%s'\n", args[1]);
+        fprintf(stderr, "Usage: set [-o|+o option] [-o option=N]\n");
+        return 1;
+    }
+
+    if (args[2] == NULL) {
+        fprintf(stderr, "set: missing option name\n");
+        return 1;
+    }
+
+    // Числовая опция: set -o maxjobs=4
+    const char *eq = strchr(args[2], '=');
+    int result = eq != NULL && value ? set_option_value(args[2], eq - args[2], eq + 1)
+                                     : set_option(args[2], value);
+    if (result == -1) {
+        fprintf(stderr, "set: %s: invalid option name\n", args[2]);
+        return 1;
+    } else if (result == -2 && eq != NULL) {
+        fprintf(stderr, "set: %.*s: option does not take a value\n", (int)(eq - args[2]), args[2]);
+        return 1;
+    } else if (result == -2) {
+        fprintf(stderr, "set: %s: option requires a value (set -o %s=N)\n", args[2], args[2]);
+        return 1;
+    } else if (result == -3) {
+        fprintf(stderr, "set: %s: invalid number\n", eq + 1);
+        return 1;
+    }
+    return 0;
+}
+
+// Счётчики запуска внешних команд: launchstat [-r]
+int launch_stat_builtin(char **args) {
+    static const char *backend_names[] = {"posix_spawn", "fork"};
+
+    if (args[1] != NULL && strcmp(args[1], "-r") == 0) {
+        reset_launch_stats();
+        printf("Launch counters reset\n");
+        return 0;
+    } else if (args[1] != NULL) {
+        fprintf(stderr, "launchstat: unknown option '%s'\n", args[1]);
+        fprintf(stderr, "Usage: launchstat [-r]\n");
+        return 1;
+    }
+
+    launch_stats_t st;
+    get_launch_stats(&st);
+
+    printf("Launch backend: %s\n", opt_spawn ? "posix_spawn" : "fork");
+    for (int i = 0; i < LAUNCH_BACKENDS; i++) {
+        double launch_us = st.launches[i] > 0 ? st.total_ns[i] / 1e3 / st.launches[i] : 0.0;
+        double wait_us = st.waits[i] > 0 ? st.wait_ns[i] / 1e3 / st.waits[i] : 0.0;
+        printf("  %-12s %8lu launches, %10.1f us to return, %10.1f us to exit\n",
+               backend_names[i], st.launches[i], launch_us, wait_us);
+    }
+    printf("  fallbacks:   %lu\n", st.fallbacks);
+    printf("  failures:    %lu\n", st.failures);
+    return 0;
+}
+
+static void print_hash_entry(const char *name, const char *path, unsigned long hits) {
+    printf("%6lu  %-16s %s\n", hits, name, path != NULL ? path : "(not found)");
+}
+
+// Таблица путей команд: hash [-r] [-s] [-d имя...] [имя...]
+int hash_builtin(char **args) {
+    if (args[1] == NULL) {
+        printf("  hits  command          path\n");
+        path_hash_foreach(print_hash_entry);
+        return 0;
+    }
+
+    if (strcmp(args[1], "-r") == 0) {
+        path_hash_clear();
+        return 0;
+    }
+
+    if (strcmp(args[1], "-s") == 0) {
+        path_hash_stats_t st;
+        get_path_hash_stats(&st);
+        printf("Path hash: %d entries, inotify %s\n", st.entries,
+               st.watching == 1 ? "on" : st.watching == 2 ? "partial" : "off");
+        printf("  hits:          %lu\n", st.hits);
+        printf("  negative hits: %lu\n", st.negative_hits);
+        printf("  misses:        %lu\n", st.misses);
+        printf("  dir probes:    %lu\n", st.dir_probes);
+        printf("  invalidations: %lu\n", st.invalidations);
+
+        exe_index_stats_t ix;
+        get_exe_index_stats(&ix);
+        if (ix.mapped) {
+            printf("Executable index: %d names in %d directories\n", ix.entries, ix.dirs);
+        } else {
+            printf("Executable index: not mapped\n");
+        }
+        printf("  hits:          %lu\n", ix.hits);
+        printf("  negative hits: %lu\n", ix.negative_hits);
+        printf("  rebuilds:      %lu\n", ix.rebuilds);
+        return 0;
+    }
+
+    if (strcmp(args[1], "-d") == 0) {
+        int status = 0;
+        for (int i = 2; args[i] != NULL; i++) {
+            if (path_hash_forget(args[i]) < 0) {
+                fprintf(stderr, "hash: %s: not found\n", args[i]);
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    if (args[1][0] == '-') {
+        fprintf(stderr, "hash: unknown option '%s'\n", args[1]);
+        fprintf(stderr, "Usage: hash [-r] [-s] [-d name...] [name...]\n");
+        return 1;
+    }
+
+    // Заполнение таблицы заранее
+    int status = 0;
+    for (int i = 1; args[i] != NULL; i++) {
+        if (is_builtin(args[i])) {
+            continue;
+        }
+        if (strchr(args[i], '/') != NULL || path_hash_lookup(args[i]) == NULL) {
+            fprintf(stderr, "hash: %s: not found\n", args[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// Потоки встроенной стадии конвейера, выполняемой в потоке shell
+// (run_builtin_thread). У основного потока контекста нет.
+static __thread const builtin_io_t *thread_io = NULL;
+
+FILE *builtin_out(void) {
+    return thread_io != NULL ? thread_io->out : stdout;
+}
+
+int builtin_in(void) {
+    return thread_io != NULL ? thread_io->in_fd : STDIN_FILENO;
+}
+
+int true_builtin(char **args) {
+    (void)args;
+    return 0;
+}
+
+int false_builtin(char **args) {
+    (void)args;
+    return 1;
+}
+
+// pwd [-L|-P]: shell не ведёт $PWD, поэтому оба режима выводят getcwd
+int pwd_builtin(char **args) {
+    for (int i = 1; args[i] != NULL; i++) {
+        if (strcmp(args[i], "-L") != 0 && strcmp(args[i], "-P") != 0) {
+            fprintf(stderr, "pwd: invalid option '%s'\n", args[i]);
+            fprintf(stderr, "Usage: pwd [-L|-P]\n");
+            return 1;
+        }
+    }
+
+    char cwd[MAX_PATH_LENGTH * 4];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        perror("pwd");
+        return 1;
+    }
+    fprintf(builtin_out(), "%s\n", cwd);
+    return 0;
+}
+
+// Разбор escape-последовательности после '\' (p указывает на символ
+// после слеша). Печатает символ и сдвигает *p. Возвращает 1 на \c:
+// вывод нужно прекратить. В стиле echo -e и %b восьмеричное число
+// начинается с \0 (до трёх цифр после нуля), в формате printf - сразу.
+static int print_escape(FILE *out, const char **p, int echo_style) {
+    const char *s = *p;
+    int c = (unsigned char)*s;
+
+    switch (c) {
+        case 'a':  putc('\a', out); break;
+        case 'b':  putc('\b', out); break;
+        case 'e':  putc('\033', out); break;
+        case 'f':  putc('\f', out); break;
+        case 'n':  putc('\n', out); break;
+        case 'r':  putc('\r', out); break;
+        case 't':  putc('\t', out); break;
+        case 'v':  putc('\v', out); break;
+        case '\\': putc('\\', out); break;
+        case 'c':
+            *p = s + 1;
+            return 1;
+        case 'x': {
+            int value = 0, digits = 0;
+            while (digits < 2 && isxdigit((unsigned char)s[1 + digits])) {
+                int d = s[1 + digits];
+                value = value * 16 + (isdigit(d) ? d - '0' : (tolower(d) - 'a' + 10));
+                digits++;
+            }
+            if (digits == 0) {
+                putc('\\', out);
+                putc('x', out);
+            } else {
+                putc(value, out);
+            }
+            s += digits;
+            break;
+        }
+        case '\0':
+            putc('\\', out);
+            *p = s;
+            return 0;
+        default:
+            if (c >= '0' && c <= '7' && (!echo_style || c == '0')) {
+                int value = 0, digits = 0;
+                if (echo_style) {
+                    s++;            // \0NNN: ноль - только префикс
+                }
+                while (digits < 3 && s[digits] >= '0' && s[digits] <= '7') {
+                    value = value * 8 + (s[digits] - '0');
+                    digits++;
+                }
+                putc(value & 0xFF, out);
+                *p = s + digits;
+                return 0;
+            }
+            putc('\\', out);
+            putc(c, out);
+            break;
+    }
+
+    *p = s + 1;
+    return 0;
+}
+
+// echo [-neE] [строка...]: как echo из coreutils. Опции распознаются,
+// только если слово целиком состоит из n, e и E.
+int echo_builtin(char **args) {
+    FILE *out = builtin_out();
+    int newline = 1;
+    int escapes = 0;
+    int i = 1;
+
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        const char *opt = args[i] + 1;
+        if (strspn(opt, "neE") != strlen(opt)) {
+            break;
+        }
+        for (; *opt; opt++) {
+            if (*opt == 'n') newline = 0;
+            else if (*opt == 'e') escapes = 1;
+            else escapes = 0;
+        }
+    }
+
+    for (int first = i; args[i] != NULL; i++) {
+        if (i > first) {
+            putc(' ', out);
+        }
+        if (!escapes) {
+            fputs(args[i], out);
+            continue;
+        }
+        for (const char *p = args[i]; *p; ) {
+            if (*p != '\\') {
+                putc(*p++, out);
+                continue;
+            }
+            p++;
+            if (print_escape(out, &p, 1)) {
+                return 0;
+            }
+        }
+    }
+
+    if (newline) {
+        putc('\n', out);
+    }
+    return 0;
+}
+
+// Числовой аргумент printf: допускается 'c (код символа)
+static int printf_number(const char *arg, int is_unsigned, long long *out_signed,
+                         unsigned long long *out_unsigned) {
+    *out_signed = 0;
+    *out_unsigned = 0;
+    if (arg[0] == '\'' || arg[0] == '"') {
+        *out_signed = (unsigned char)arg[1];
+        *out_unsigned = (unsigned char)arg[1];
+        return 0;
+    }
+
+    char *end;
+    errno = 0;
+    if (is_unsigned && arg[0] != '-') {
+        *out_unsigned = strtoull(arg, &end, 0);
+        *out_signed = (long long)*out_unsigned;
+    } else {
+        *out_signed = strtoll(arg, &end, 0);
+        *out_unsigned = (unsigned long long)*out_signed;
+    }
+    if (end == arg || *end != '\0' || errno != 0) {
+        fprintf(stderr, "printf: '%s': expected a numeric value\n", arg);
+        return -1;
+    }
+    return 0;
+}
+
+// printf формат [аргумент...]: формат повторяется, пока аргументы не
+// кончатся. Поддерживаются %s %b %c %d %i %u %o %x %X %f %e %g %E %G %%
+// с флагами, шириной и точностью (в том числе *).
+int printf_builtin(char **args) {
+    if (args[1] == NULL) {
+        fprintf(stderr, "printf: missing format\n");
+        fprintf(stderr, "Usage: printf format [argument...]\n");
+        return 1;
+    }
+
+    FILE *out = builtin_out();
+    const char *format = args[1];
+    char **argp = args + 2;
+    int status = 0;
+
+    do {
+        char **start = argp;
+
+        for (const char *f = format; *f; ) {
+            if (*f == '\\') {
+                f++;
+                if (print_escape(out, &f, 0)) {
+                    return status;
+                }
+                continue;
+            }
+            if (*f != '%') {
+                putc(*f++, out);
+                continue;
+            }
+            if (f[1] == '%') {
+                putc('%', out);
+                f += 2;
+                continue;
+            }
+
+            // Спецификация собирается в отдельную строку для printf из libc
+            char spec[64];
+            size_t n = 0;
+            spec[n++] = *f++;
+            while (*f && strchr("-+ #0", *f) && n < 20) {
+                spec[n++] = *f++;
+            }
+
+            int star_values[2];
+            int stars = 0;
+            for (int part = 0; part < 2; part++) {
+                if (part == 1) {
+                    if (*f != '.') break;
+                    spec[n++] = *f++;
+                }
+                if (*f == '*') {
+                    long long value = 0;
+                    unsigned long long unused;
+                    if (*argp != NULL && printf_number(*argp, 0, &value, &unused) < 0) {
+                        status = 1;
+                    }
+                    if (*argp != NULL) argp++;
+                    star_values[stars++] = (int)value;
+                    spec[n++] = '*';
+                    f++;
+                } else {
+                    while (isdigit((unsigned char)*f) && n < 40) {
+                        spec[n++] = *f++;
+                    }
+                }
+            }
+
+            // Модификаторы длины игнорируются: числа всегда long long
+            while (*f && strchr("hlLqjzt", *f)) {
+                f++;
+            }
+
+            char conv = *f;
+            if (conv == '\0' || strchr("sbcdiuoxXfeEgGaA", conv) == NULL) {
+                fprintf(stderr, "printf: %%%c: invalid conversion specification\n", conv ? conv : ' ');
+                return 1;
+            }
+            f++;
+
+            const char *arg = *argp != NULL ? *argp++ : NULL;
+
+            if (conv == 'b') {
+                // %b: аргумент с escape-последовательностями
+                for (const char *p = arg ? arg : ""; *p; ) {
+                    if (*p != '\\') {
+                        putc(*p++, out);
+                        continue;
+                    }
+                    p++;
+                    if (print_escape(out, &p, 1)) {
+                        return status;
+                    }
+                }
+                continue;
+            }
+
+            if (strchr("diouxX", conv)) {
+                spec[n++] = 'l';
+                spec[n++] = 'l';
+            }
+            spec[n++] = conv;
+            spec[n] = '\0';
+
+            long long sval = 0;
+            unsigned long long uval = 0;
+            double dval = 0;
+
+            switch (conv) {
+                case 's':
+                case 'c': {
+                    const char *str = arg ? arg : "";
+                    if (conv == 'c') {
+                        // %c печатает первый символ аргумента
+                        spec[n - 1] = 'c';
+                        int ch = str[0];
+                        if (stars == 2) fprintf(out, spec, star_values[0], star_values[1], ch);
+                        else if (stars == 1) fprintf(out, spec, star_values[0], ch);
+                        else fprintf(out, spec, ch);
+                    } else {
+                        if (stars == 2) fprintf(out, spec, star_values[0], star_values[1], str);
+                        else if (stars == 1) fprintf(out, spec, star_values[0], str);
+                        else fprintf(out, spec, str);
+                    }
+                    break;
+                }
+                case 'd':
+                case 'i':
+                    if (arg != NULL && printf_number(arg, 0, &sval, &uval) < 0) status = 1;
+                    if (stars == 2) fprintf(out, spec, star_values[0], star_values[1], sval);
+                    else if (stars == 1) fprintf(out, spec, star_values[0], sval);
+                    else fprintf(out, spec, sval);
+                    break;
+                case 'o':
+                case 'u':
+                case 'x':
+                case 'X':
+                    if (arg != NULL && printf_number(arg, 1, &sval, &uval) < 0) status = 1;
+                    if (stars == 2) fprintf(out, spec, star_values[0], star_values[1], uval);
+                    else if (stars == 1) fprintf(out, spec, star_values[0], uval);
+                    else fprintf(out, spec, uval);
+                    break;
+                default: {
+                    if (arg != NULL) {
+                        char *end;
+                        dval = strtod(arg, &end);
+                        if (end == arg || *end != '\0') {
+                            fprintf(stderr, "printf: '%s': expected a numeric value\n", arg);
+                            status = 1;
+                        }
+                    }
+                    if (stars == 2) fprintf(out, spec, star_values[0], star_values[1], dval);
+                    else if (stars == 1) fprintf(out, spec, star_values[0], dval);
+                    else fprintf(out, spec, dval);
+                    break;
+                }
+            }
+        }
+
+        // Формат без преобразований не потребляет аргументы
+        if (argp == start) {
+            break;
+        }
+    } while (*argp != NULL);
+
+    return status;
+}
+
+// Кэш stat для test/[ в пределах одной строки: цепочки вида
+// [ -e f ] && [ -r f ] && [ -x f ] обращаются к ФС один раз. Кэш
+// сбрасывается перед любой другой командой (она может изменить ФС или
+// текущий каталог) и в конце строки.
+#define STAT_CACHE_SIZE 16
+
+typedef struct {
+    char *path;          // Во временной арене строки
+    int follow;          // stat (1) или lstat (0)
+    int result;          // Результат вызова
+    struct stat st;
+} stat_cache_entry_t;
+
+static stat_cache_entry_t stat_cache[STAT_CACHE_SIZE];
+static int stat_cache_count = 0;
+static int stat_cache_next = 0;       // Следующая вытесняемая запись
+
+void stat_cache_invalidate(void) {
+    stat_cache_count = 0;
+}
+
+static int cached_stat(const char *path, int follow, struct stat *st) {
+    // Кэш и арена строки принадлежат основному потоку
+    if (thread_io != NULL) {
+        return follow ? stat(path, st) : lstat(path, st);
+    }
+
+    for (int i = 0; i < stat_cache_count; i++) {
+        if (stat_cache[i].follow == follow && strcmp(stat_cache[i].path, path) == 0) {
+            *st = stat_cache[i].st;
+            return stat_cache[i].result;
+        }
+    }
+
+    int result = follow ? stat(path, st) : lstat(path, st);
+
+    // Запоминаем по кругу: старые записи вытесняются новыми
+    stat_cache_entry_t *e;
+    if (stat_cache_count < STAT_CACHE_SIZE) {
+        e = &stat_cache[stat_cache_count++];
+    } else {
+        e = &stat_cache[stat_cache_next];
+        stat_cache_next = (stat_cache_next + 1) % STAT_CACHE_SIZE;
+    }
+    e->path = arena_strdup(line_arena, path);
+    if (e->path == NULL) {
+        stat_cache_count = 0;
+        return result;
+    }
+    e->follow = follow;
+    e->result = result;
+    e->st = *st;
+    return result;
+}
+
+// Разбор выражения test: argv[pos..argc), результат 1/0, ошибка - -1
+typedef struct {
+    char **argv;
+    int argc;
+    int pos;
+} test_state_t;
+
+static int test_expr(test_state_t *t);
+
+static int test_error(const char *message, const char *arg) {
+    if (arg != NULL) {
+        fprintf(stderr, "test: %s: %s\n", arg, message);
+    } else {
+        fprintf(stderr, "test: %s\n", message);
+    }
+    return -1;
+}
+
+static int is_unary_op(const char *s) {
+    return s[0] == '-' && s[1] != '\0' && s[2] == '\0' &&
+           strchr("bcdefghLnprsStuwxzOG", s[1]) != NULL;
+}
+
+static int is_binary_op(const char *s) {
+    static const char *ops[] = {"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le",
+                                "-gt", "-ge", "-nt", "-ot", "-ef", NULL};
+    for (int i = 0; ops[i] != NULL; i++) {
+        if (strcmp(s, ops[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static int test_integer(const char *s, long long *out) {
+    char *end;
+    errno = 0;
+    *out = strtoll(s, &end, 10);
+    while (isspace((unsigned char)*end)) end++;
+    if (end == s || *end != '\0' || errno != 0) {
+        return test_error("integer expression expected", s);
+    }
+    return 0;
+}
+
+static int test_unary(const char *op, const char *arg) {
+    struct stat st;
+
+    switch (op[1]) {
+        case 'n': return arg[0] != '\0';
+        case 'z': return arg[0] == '\0';
+        case 't': {
+            long long fd;
+            if (test_integer(arg, &fd) < 0) return -1;
+            // В потоке конвейера 0 и 1 - концы pipe'ов стадии, а не
+            // дескрипторы shell; stderr у потоков общий
+            if (fd == STDIN_FILENO) {
+                fd = builtin_in();
+            } else if (fd == STDOUT_FILENO) {
+                fd = fileno(builtin_out());
+            }
+            return isatty((int)fd);
+        }
+        case 'h':
+        case 'L':
+            return cached_stat(arg, 0, &st) == 0 && S_ISLNK(st.st_mode);
+        case 'r': return access(arg, R_OK) == 0;
+        case 'w': return access(arg, W_OK) == 0;
+        case 'x': return access(arg, X_OK) == 0;
+        default:
+            break;
+    }
+
+    if (cached_stat(arg, 1, &st) != 0) {
+        return 0;
+    }
+    switch (op[1]) {
+        case 'e': return 1;
+        case 'f': return S_ISREG(st.st_mode);
+        case 'd': return S_ISDIR(st.st_mode);
+        case 'b': return S_ISBLK(st.st_mode);
+        case 'c': return S_ISCHR(st.st_mode);
+        case 'p': return S_ISFIFO(st.st_mode);
+        case 'S': return S_ISSOCK(st.st_mode);
+        case 's': return st.st_size > 0;
+        case 'g': return (st.st_mode & S_ISGID) != 0;
+        case 'u': return (st.st_mode & S_ISUID) != 0;
+        case 'O': return st.st_uid == geteuid();
+        case 'G': return st.st_gid == getegid();
+        default:  return test_error("unary operator expected", op);
+    }
+}
+
+static int test_binary(const char *left, const char *op, const char *right) {
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) return strcmp(left, right) == 0;
+    if (strcmp(op, "!=") == 0) return strcmp(left, right) != 0;
+    if (strcmp(op, "<") == 0) return strcmp(left, right) < 0;
+    if (strcmp(op, ">") == 0) return strcmp(left, right) > 0;
+
+    if (strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0) {
+        struct stat a, b;
+        int have_a = cached_stat(left, 1, &a) == 0;
+        int have_b = cached_stat(right, 1, &b) == 0;
+        if (op[1] == 'e') {
+            return have_a && have_b && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+        }
+        // Несуществующий файл старше любого существующего
+        if (!have_a || !have_b) {
+            return op[1] == 'n' ? (have_a && !have_b) : (!have_a && have_b);
+        }
+        int cmp = (a.st_mtim.tv_sec > b.st_mtim.tv_sec) - (a.st_mtim.tv_sec < b.st_mtim.tv_sec);
+        if (cmp == 0) {
+            cmp = (a.st_mtim.tv_nsec > b.st_mtim.tv_nsec) - (a.st_mtim.tv_nsec < b.st_mtim.tv_nsec);
+        }
+        return op[1] == 'n' ? cmp > 0 : cmp < 0;
+    }
+
+    long long l, r;
+    if (test_integer(left, &l) < 0 || test_integer(right, &r) < 0) {
+        return -1;
+    }
+    if (strcmp(op, "-eq") == 0) return l == r;
+    if (strcmp(op, "-ne") == 0) return l != r;
+    if (strcmp(op, "-lt") == 0) return l < r;
+    if (strcmp(op, "-le") == 0) return l <= r;
+    if (strcmp(op, "-gt") == 0) return l > r;
+    return l >= r;
+}
+
+static int test_primary(test_state_t *t) {
+    if (t->pos >= t->argc) {
+        return test_error("argument expected", NULL);
+    }
+    char *arg = t->argv[t->pos];
+
+    // Бинарный оператор важнее унарного: [ -n = -n ]
+    if (t->pos + 2 < t->argc && is_binary_op(t->argv[t->pos + 1])) {
+        t->pos += 3;
+        return test_binary(arg, t->argv[t->pos - 2], t->argv[t->pos - 1]);
+    }
+
+    if (strcmp(arg, "(") == 0) {
+        t->pos++;
+        int result = test_expr(t);
+        if (result < 0) return -1;
+        if (t->pos >= t->argc || strcmp(t->argv[t->pos], ")") != 0) {
+            return test_error("')' expected", NULL);
+        }
+        t->pos++;
+        return result;
+    }
+
+    if (is_unary_op(arg) && t->pos + 1 < t->argc) {
+        t->pos += 2;
+        return test_unary(arg, t->argv[t->pos - 1]);
+    }
+
+    t->pos++;
+    return arg[0] != '\0';
+}
+
+static int test_not(test_state_t *t) {
+    if (t->pos < t->argc && strcmp(t->argv[t->pos], "!") == 0 && t->pos + 1 < t->argc) {
+        t->pos++;
+        int result = test_not(t);
+        return result < 0 ? -1 : !result;
+    }
+    return test_primary(t);
+}
+
+static int test_and(test_state_t *t) {
+    int result = test_not(t);
+    while (result >= 0 && t->pos < t->argc && strcmp(t->argv[t->pos], "-a") == 0) {
+        t->pos++;
+        int right = test_not(t);
+        result = right < 0 ? -1 : (result && right);
+    }
+    return result;
+}
+
+static int test_expr(test_state_t *t) {
+    int result = test_and(t);
+    while (result >= 0 && t->pos < t->argc && strcmp(t->argv[t->pos], "-o") == 0) {
+        t->pos++;
+        int right = test_and(t);
+        result = right < 0 ? -1 : (result || right);
+    }
+    return result;
+}
+
+// Вычисление test по POSIX: до четырёх аргументов смысл определяется
+// их числом, длиннее - разбор с ! -a -o и скобками
+static int test_evaluate(char **argv, int argc) {
+    test_state_t t = {argv, argc, 0};
+
+    switch (argc) {
+        case 0:
+            return 0;
+        case 1:
+            return argv[0][0] != '\0';
+        case 2:
+            if (strcmp(argv[0], "!") == 0) return argv[1][0] == '\0';
+            if (is_unary_op(argv[0])) return test_unary(argv[0], argv[1]);
+            return test_error("unary operator expected", argv[0]);
+        case 3:
+            if (is_binary_op(argv[1])) return test_binary(argv[0], argv[1], argv[2]);
+            if (strcmp(argv[0], "!") == 0) {
+                int result = test_evaluate(argv + 1, 2);
+                return result < 0 ? -1 : !result;
+            }
+            if (strcmp(argv[0], "(") == 0 && strcmp(argv[2], ")") == 0) {
+                return argv[1][0] != '\0';
+            }
+            break;
+        case 4:
+            if (strcmp(argv[0], "!") == 0) {
+                int result = test_evaluate(argv + 1, 3);
+                return result < 0 ? -1 : !result;
+            }
+            if (strcmp(argv[0], "(") == 0 && strcmp(argv[3], ")") == 0) {
+                return test_evaluate(argv + 1, 2);
+            }
+            break;
+    }
+
+    int result = test_expr(&t);
+    if (result >= 0 && t.pos < argc) {
+        return test_error("too many arguments", NULL);
+    }
+    return result;
+}
+
+static int test_status(int result) {
+    return result < 0 ? 2 : !result;
+}
+
+// test выражение: 0 - истина, 1 - ложь, 2 - ошибка
+int test_builtin(char **args) {
+    int argc = 0;
+    while (args[argc] != NULL) {
+        argc++;
+    }
+    return test_status(test_evaluate(args + 1, argc - 1));
+}
+
+// [ выражение ]
+int bracket_builtin(char **args) {
+    int argc = 0;
+    while (args[argc] != NULL) {
+        argc++;
+    }
+    if (strcmp(args[argc - 1], "]") != 0) {
+        fprintf(stderr, "[: missing ']'\n");
+        return 2;
+    }
+    return test_status(test_evaluate(args + 1, argc - 2));
+}
+
+// Реестр встроенных команд. Поиск - совершенный хэш из
+// builtins_hash.h: одна ячейка и одно сравнение строк на любое имя,
+// поэтому внешние команды не платят за перебор всех встроенных.
+static builtin_t builtins[] = {
+#define BUILTIN(n, f, fl) {.name = n, .func = f, .flags = fl},
+#include "builtins.def"
+#undef BUILTIN
+};
+
+#include "builtins_hash.h"
+
+#define BUILTIN_COUNT ((int)(sizeof(builtins) / sizeof(builtins[0])))
+
+// Команды, загруженные через enable -f. Их немного, поэтому они
+// просматриваются по порядку и только если имя не нашлось в реестре.
+#define LOADED_MAX 64
+
+static builtin_t loaded[LOADED_MAX];
+static int loaded_count = 0;
+
+extern char **environ;
+
+static builtin_t *lookup_builtin(const char *name) {
+    int index = builtin_slots[builtin_hash(name, BUILTIN_HASH_SEED) & (BUILTIN_HASH_SIZE - 1)];
+    if (index >= 0 && strcmp(builtins[index].name, name) == 0) {
+        return &builtins[index];
+    }
+
+    for (int i = 0; i < loaded_count; i++) {
+        if (strcmp(loaded[i].name, name) == 0) {
+            return &loaded[i];
+        }
+    }
+    return NULL;
+}
+
+// Включённая встроенная команда с таким именем или NULL
+const builtin_t *find_builtin(const char *name) {
+    const builtin_t *builtin = lookup_builtin(name);
+    if (builtin == NULL || (builtin->flags & BUILTIN_DISABLED)) {
+        return NULL;
+    }
+    return builtin;
+}
+
+int is_builtin(const char *name) {
+    return name != NULL && find_builtin(name) != NULL;
+}
+
+// Вызов встроенной команды. Загруженные получают argc/argv и
+// дескрипторы стандартных потоков по ABI из loadable.h.
+int run_builtin(const builtin_t *builtin, char **args) {
+    // Любая команда, кроме самой test, может изменить файлы или каталог
+    if (builtin->func != test_builtin && builtin->func != bracket_builtin) {
+        stat_cache_invalidate();
+    }
+
+    if (builtin->loadable == NULL) {
+        return builtin->func(args);
+    }
+
+    int argc = 0;
+    while (args[argc] != NULL) {
+        argc++;
+    }
+
+    shell_builtin_io_t io = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, environ};
+    fflush(stdout);
+    fflush(stderr);
+    int result = builtin->loadable->run(argc, args, &io);
+    fflush(stdout);
+    fflush(stderr);
+    return result;
+}
+
+// Вызов встроенной команды с флагом BUILTIN_THREAD в потоке стадии
+// конвейера: вывод идёт в io->out, ввод читается из io->in_fd
+int run_builtin_thread(const builtin_t *builtin, char **args, const builtin_io_t *io) {
+    thread_io = io;
+    int result = builtin->func(args);
+    fflush(io->out);
+    thread_io = NULL;
+    return result;
+}
+
+static void print_builtin(const builtin_t *builtin) {
+    printf("%-8s %-12s", (builtin->flags & BUILTIN_DISABLED) ? "disabled" : "enabled",
+           builtin->name);
+    if (builtin->flags & BUILTIN_NOFORK) printf(" nofork");
+    if (builtin->flags & BUILTIN_STATE) printf(" state");
+    if (builtin->flags & BUILTIN_THREAD) printf(" thread");
+    if (builtin->loadable != NULL) printf(" loaded");
+    printf("\n");
+}
+
+// Загрузка команды name из библиотеки path (enable -f)
+static int load_builtin(const char *path, const char *name) {
+    if (lookup_builtin(name) != NULL) {
+        fprintf(stderr, "enable: %s: builtin already exists\n", name);
+        return 1;
+    }
+    if (loaded_count == LOADED_MAX) {
+        fprintf(stderr, "enable: too many loadable builtins\n");
+        return 1;
+    }
+
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "enable: %s\n", dlerror());
+        return 1;
+    }
+
+    char symbol[256];
+    snprintf(symbol, sizeof(symbol), "%s_builtin", name);
+    const shell_loadable_t *loadable = dlsym(handle, symbol);
+    if (loadable == NULL) {
+        fprintf(stderr, "enable: %s: no %s in %s\n", name, symbol, path);
+        dlclose(handle);
+        return 1;
+    }
+    if (loadable->abi_version != SHELL_LOADABLE_ABI_VERSION || loadable->run == NULL ||
+        loadable->name == NULL || strcmp(loadable->name, name) != 0) {
+        fprintf(stderr, "enable: %s: incompatible builtin (ABI %d, expected %d)\n",
+                name, loadable->abi_version, SHELL_LOADABLE_ABI_VERSION);
+        dlclose(handle);
+        return 1;
+    }
+    if (loadable->load != NULL && loadable->load() != 0) {
+        fprintf(stderr, "enable: %s: initialization failed\n", name);
+        dlclose(handle);
+        return 1;
+    }
+
+    builtin_t *builtin = &loaded[loaded_count++];
+    builtin->name = loadable->name;
+    builtin->func = NULL;
+    builtin->flags = BUILTIN_NOFORK;
+    if (loadable->flags & SHELL_LOADABLE_STATE) {
+        builtin->flags |= BUILTIN_STATE;
+    }
+    builtin->loadable = loadable;
+    builtin->handle = handle;
+    return 0;
+}
+
+// Выгрузка команды, загруженной через enable -f (enable -d)
+static int unload_builtin(const char *name) {
+    for (int i = 0; i < loaded_count; i++) {
+        if (strcmp(loaded[i].name, name) != 0) {
+            continue;
+        }
+        if (loaded[i].loadable->unload != NULL) {
+            loaded[i].loadable->unload();
+        }
+        dlclose(loaded[i].handle);
+        loaded[i] = loaded[--loaded_count];
+        return 0;
+    }
+
+    fprintf(stderr, "enable: %s: not a loadable builtin\n", name);
+    return 1;
+}
+
+// Включение и выключение встроенных команд:
+//   enable [-a] [-n] [имя...]     - список, выключение (-n), включение
+//   enable -f библиотека имя...   - загрузка команд из разделяемой библиотеки
+//   enable -d имя...              - выгрузка загруженных команд
+// Выключенное имя ищется в PATH как внешняя команда.
+int enable_builtin(char **args) {
+    int disable = 0;
+    int all = 0;
+    int unload = 0;
+    const char *library = NULL;
+    int i = 1;
+
+    for (; args[i] != NULL && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-n") == 0) {
+            disable = 1;
+        } else if (strcmp(args[i], "-a") == 0) {
+            all = 1;
+        } else if (strcmp(args[i], "-d") == 0) {
+            unload = 1;
+        } else if (strcmp(args[i], "-f") == 0 && args[i + 1] != NULL) {
+            library = args[++i];
+        } else {
+            fprintf(stderr, "enable: unknown option '%s'\n", args[i]);
+            fprintf(stderr, "Usage: enable [-a] [-n] [-d] [-f library] [name...]\n");
+            return 1;
+        }
+    }
+
+    if (args[i] == NULL) {
+        if (library != NULL || unload) {
+            fprintf(stderr, "enable: missing builtin name\n");
+            return 1;
+        }
+        for (int j = 0; j < BUILTIN_COUNT + loaded_count; j++) {
+            const builtin_t *builtin = j < BUILTIN_COUNT ? &builtins[j] : &loaded[j - BUILTIN_COUNT];
+            int disabled = (builtin->flags & BUILTIN_DISABLED) != 0;
+            if (all || disabled == disable) {
+                print_builtin(builtin);
+            }
+        }
+        return 0;
+    }
+
+    int status = 0;
+    if (library != NULL || unload) {
+        for (; args[i] != NULL; i++) {
+            status |= library != NULL ? load_builtin(library, args[i]) : unload_builtin(args[i]);
+        }
+        return status;
+    }
+
+    for (; args[i] != NULL; i++) {
+        builtin_t *builtin = lookup_builtin(args[i]);
+        if (builtin == NULL) {
+            fprintf(stderr, "enable: %s: not a shell builtin\n", args[i]);
+            status = 1;
+        } else if (disable) {
+            if (strcmp(builtin->name, "enable") == 0) {
+                fprintf(stderr, "enable: cannot disable enable\n");
+                status = 1;
+                continue;
+            }
+            builtin->flags |= BUILTIN_DISABLED;
+        } else {
+            builtin->flags &= ~BUILTIN_DISABLED;
+        }
+    }
+    return status;
+}
+
+// Явный вызов встроенной команды: builtin [имя [аргументы...]]
+// Без аргументов - список всех встроенных команд с флагами.
+int builtin_builtin(char **args) {
+    if (args[1] == NULL) {
+        for (int j = 0; j < BUILTIN_COUNT; j++) {
+            print_builtin(&builtins[j]);
+        }
+        for (int j = 0; j < loaded_count; j++) {
+            print_builtin(&loaded[j]);
+        }
+        return 0;
+    }
+
+    const builtin_t *builtin = find_builtin(args[1]);
+    if (builtin == NULL) {
+        fprintf(stderr, "builtin: %s: not a shell builtin\n", args[1]);
+        return 1;
+    }
+    return run_builtin(builtin, args + 1);
+}
+
 int execute_bash_cmd(char **args) {
     if (args[0] == NULL) {
         return 1;
     }
 
-    if (strcmp(args[0], "cd") == 0) {
-        return from_bash_cd(args);
-    } else if (strcmp(args[0], "exit") == 0) {
-        return from_bash_exit(args);
-    } else if (strcmp(args[0], "path") == 0) {
-        return from_path(args);
-    } else if (strcmp(args[0], "setpath") == 0) {
-        return set_path(args);
-    } else if (strcmp(args[0], "addpath") == 0) {
-        return add_to_path(args);
-    } else if (strcmp(args[0], "resetpath") == 0) {
-        return reset_path(args);
-    } else if (strcmp(args[0], "history") == 0) {  // НОВАЯ КОМАНДА
-        return show_history(args);
+    const builtin_t *builtin = find_builtin(args[0]);
+    if (builtin == NULL) {
+        return -1; // Не встроенная команда
     }
-
-    return -1; // Не встроенная команда
-}
\ No newline at end of file
+    return run_builtin(builtin, args);
+}
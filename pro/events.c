@@ -0,0 +1,248 @@
+#define _GNU_SOURCE
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+// Цикл событий интерактивного shell. Пока shell ждёт ввода, он спит в
+// epoll_wait на трёх видах источников:
+//   - терминал (stdin) - очередной байт строки;
+//   - signalfd с SIGCHLD, SIGINT и SIGWINCH - сигналы заблокированы и
+//     читаются как обычные данные, обработчиков сигналов нет;
+//   - pidfd каждого процесса фонового задания - завершение конкретного
+//     процесса без обхода всех потомков.
+// События обрабатываются синхронно, и все изменения заданий за одно
+// пробуждение выводятся одним уведомлением. Без событий shell не
+// тратит ни одного системного вызова.
+
+struct event_source {
+    int fd;
+    void (*ready)(void *arg);
+    void *arg;
+};
+
+static int epoll_fd = -1;
+static int signal_fd = -1;
+static event_source_t stdin_source;
+static event_source_t signal_source;
+
+#define NOTIFY_DELAY_MS 20          // Сбор одновременных завершений
+
+static int interrupted = 0;          // Пришёл SIGINT
+static int terminal_columns = 80;    // Ширина терминала (SIGWINCH)
+
+static void update_columns(void) {
+    struct winsize ws;
+    if (ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+        terminal_columns = ws.ws_col;
+    }
+}
+
+int events_columns(void) {
+    return terminal_columns;
+}
+
+static void signals_ready(void *arg) {
+    (void)arg;
+    struct signalfd_siginfo info;
+    int child = 0;
+
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        switch (info.ssi_signo) {
+            case SIGCHLD:
+                child = 1;
+                break;
+            case SIGINT:
+                interrupted = 1;
+                break;
+            case SIGWINCH:
+                update_columns();
+                break;
+        }
+    }
+
+    // Остановки и продолжения фоновых заданий pidfd не сообщает
+    if (child) {
+        jobs_reap();
+    }
+}
+
+static int add_source(event_source_t *source, unsigned events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = source;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, source->fd, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+// epoll, signalfd и блокировка сигналов. Без них shell читает терминал
+// напрямую и собирает задания перед приглашением.
+int events_init(void) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGWINCH);
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    // SIGINT не игнорируется, а блокируется: иначе он не попадёт в
+    // signalfd. Потомки получают пустую маску при запуске.
+    sigprocmask(SIG_BLOCK, &set, NULL);
+    signal_fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        perror("signalfd");
+    } else {
+        stdin_source.fd = STDIN_FILENO;
+        signal_source.fd = signal_fd;
+        signal_source.ready = signals_ready;
+        if (add_source(&stdin_source, EPOLLIN) == 0 && add_source(&signal_source, EPOLLIN) == 0) {
+            signal(SIGINT, SIG_DFL);
+            update_columns();
+            return 0;
+        }
+        close(signal_fd);
+        signal_fd = -1;
+    }
+
+    sigprocmask(SIG_UNBLOCK, &set, NULL);
+    close(epoll_fd);
+    epoll_fd = -1;
+    return -1;
+}
+
+int events_active(void) {
+    return epoll_fd >= 0;
+}
+
+// pidfd процесса: готов к чтению, когда процесс завершился. Событие
+// однократное (EPOLLONESHOT): pidfd собранного процесса остаётся
+// готовым. NULL, если ядро без pidfd_open - тогда хватает SIGCHLD.
+event_source_t *events_watch_pid(pid_t pid, void (*ready)(void *arg), void *arg) {
+    if (epoll_fd < 0) {
+        return NULL;
+    }
+
+    // pidfd создаётся с close-on-exec
+    int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    event_source_t *source = malloc(sizeof(event_source_t));
+    if (source == NULL) {
+        close(fd);
+        return NULL;
+    }
+    source->fd = fd;
+    source->ready = ready;
+    source->arg = arg;
+    if (add_source(source, EPOLLIN | EPOLLONESHOT) < 0) {
+        close(fd);
+        free(source);
+        return NULL;
+    }
+    return source;
+}
+
+// Снятие pidfd с наблюдения. Явный EPOLL_CTL_DEL: копию pidfd может
+// держать потомок, выполняющий встроенную команду, и тогда close не
+// убрал бы его из epoll.
+void events_unwatch_pid(event_source_t *source) {
+    if (source != NULL) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+        close(source->fd);
+        free(source);
+    }
+}
+
+// Сигналы, пришедшие, пока исполнялась строка: Ctrl-C для встроенной
+// команды переднего плана не должен прервать следующую строку
+void events_discard_signals(void) {
+    if (signal_fd >= 0) {
+        signals_ready(NULL);
+        interrupted = 0;
+    }
+}
+
+// Одно ожидание epoll_wait: обработка всех готовых источников, кроме
+// терминала, *input - готов ли терминал. Возвращает число событий
+// (0 - истёк таймаут) или -1 при ошибке.
+static int dispatch(int timeout_ms, int *input) {
+    struct epoll_event events[16];
+    int n = epoll_wait(epoll_fd, events, 16, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        perror("epoll_wait");
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        event_source_t *source = events[i].data.ptr;
+        if (source == &stdin_source) {
+            *input = 1;
+        } else {
+            source->ready(source->arg);
+        }
+    }
+    return n;
+}
+
+// Очередной байт терминала. Пока его нет, обрабатываются остальные
+// события. Возвращает KEY_INTERRUPT после Ctrl-C, KEY_NOTIFY, если
+// allow_notify и изменились фоновые задания, и KEY_EOF при закрытии
+// терминала. После первого изменения события ещё NOTIFY_DELAY_MS
+// собираются без вывода: задания, завершившиеся вместе, попадают в
+// одно уведомление.
+int events_read_key(int allow_notify) {
+    for (;;) {
+        if (allow_notify && jobs_pending()) {
+            return KEY_NOTIFY;
+        }
+
+        int input = 0;
+        if (dispatch(-1, &input) < 0) {
+            return KEY_EOF;
+        }
+        if (allow_notify && jobs_pending()) {
+            while (!input && !interrupted && dispatch(NOTIFY_DELAY_MS, &input) > 0) {
+                continue;
+            }
+        }
+
+        if (interrupted) {
+            interrupted = 0;
+            return KEY_INTERRUPT;
+        }
+        if (allow_notify && jobs_pending()) {
+            return KEY_NOTIFY;
+        }
+        if (input) {
+            unsigned char c;
+            ssize_t got = read(STDIN_FILENO, &c, 1);
+            if (got == 1) {
+                return c;
+            }
+            if (got == 0 || (errno != EINTR && errno != EAGAIN)) {
+                return KEY_EOF;
+            }
+        }
+    }
+}
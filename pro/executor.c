@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "shell.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,82 +8,51 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
 
-// Функция для применения перенаправлений
+// Функция для применения перенаправлений: список операций
+// выполняется по порядку за один проход
 int apply_redirections(command_t *cmd) {
-    // Перенаправление ввода (stdin)
-    if (cmd->input_file != NULL) {
-        int fd = open(cmd->input_file, O_RDONLY);
-        if (fd < 0) {
-            perror("open input");
-            return -1;
-        }
-        
-        if (dup2(fd, STDIN_FILENO) < 0) {
-            perror("dup2 stdin");
-            close(fd);
-            return -1;
-        }
-        close(fd);
-    }
-    
-    // Перенаправление вывода (stdout)
-    if (cmd->output_file != NULL) {
-        int flags = O_WRONLY | O_CREAT;
-        if (cmd->append_output) {
-            flags |= O_APPEND;
-        } else {
-            flags |= O_TRUNC;
-        }
-        
-        int fd = open(cmd->output_file, flags, 0644);
-        if (fd < 0) {
-            perror("open output");
-            return -1;
-        }
-        
-        if (dup2(fd, STDOUT_FILENO) < 0) {
-            perror("dup2 stdout");
-            close(fd);
-            return -1;
-        }
-        close(fd);
-    }
-    
-    // Перенаправление ошибок (stderr)
-    if (cmd->error_file != NULL) {
-        int flags = O_WRONLY | O_CREAT;
-        if (cmd->append_error) {
-            flags |= O_APPEND;
-        } else {
-            flags |= O_TRUNC;
-        }
-        
-        int fd = open(cmd->error_file, flags, 0644);
-        if (fd < 0) {
-            perror("open error");
-            return -1;
-        }
-        
-        if (dup2(fd, STDERR_FILENO) < 0) {
-            perror("dup2 stderr");
-            close(fd);
-            return -1;
-        }
-        close(fd);
-    }
-    
-    // Объединение stderr с stdout
-    if (cmd->merge_output) {
-        if (dup2(STDOUT_FILENO, STDERR_FILENO) < 0) {
-            perror("dup2 merge");
-            return -1;
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        const redirect_t *r = &cmd->redirects[i];
+
+        switch (r->op) {
+            case REDIR_OPEN: {
+                int fd = open(r->path, r->flags, 0644);
+                if (fd < 0) {
+                    fprintf(stderr, "%s: %s\n", r->path, strerror(errno));
+                    return -1;
+                }
+                if (fd != r->fd) {
+                    if (dup2(fd, r->fd) < 0) {
+                        perror("dup2");
+                        close(fd);
+                        return -1;
+                    }
+                    close(fd);
+                }
+                break;
+            }
+
+            case REDIR_DUP:
+                if (dup2(r->src_fd, r->fd) < 0) {
+                    perror("dup2");
+                    return -1;
+                }
+                break;
+
+            case REDIR_CLOSE:
+                close(r->fd);
+                break;
         }
     }
     
     return 0;
 }
 
+// Полный путь к команде. Строка лежит во временной арене строки
+// и живёт до конца исполнения строки.
 char *get_full_path(const char *command) {
     if (command == NULL || command[0] == '\0') {
         return NULL;
@@ -92,53 +62,13 @@ char *get_full_path(const char *command) {
     if (command[0] == '/' || (command[0] == '.' && (command[1] == '/' || 
         (command[1] == '.' && command[2] == '/')))) {
         if (access(command, X_OK) == 0) {
-            return strdup(command);
+            return arena_strdup(line_arena, command);
         }
         return NULL;
     }
 
-    char *path_env = getenv("PATH");
-    if (path_env == NULL) {
-        return NULL;
-    }
-
-    char *path_copy = strdup(path_env);
-    if (path_copy == NULL) {
-        perror("strdup");
-        return NULL;
-    }
-
-    char *dir = strtok(path_copy, ":");
-    char *found_path = NULL;
-
-    while (dir != NULL) {
-        // Проверка длины пути
-        size_t dir_len = strlen(dir);
-        size_t cmd_len = strlen(command);
-        
-        if (dir_len + cmd_len + 2 > MAX_PATH_LENGTH) {
-            dir = strtok(NULL, ":");
-            continue;
-        }
-
-        char full_path[MAX_PATH_LENGTH];
-        int written = snprintf(full_path, sizeof(full_path), "%s/%s", dir, command);
-        
-        if (written < 0 || written >= (int)sizeof(full_path)) {
-            dir = strtok(NULL, ":");
-            continue;
-        }
-
-        if (access(full_path, X_OK) == 0) {
-            found_path = strdup(full_path);
-            break;
-        }
-
-        dir = strtok(NULL, ":");
-    }
-
-    free(path_copy);
-    return found_path;
+    // Остальные ищутся по PATH через таблицу путей
+    return path_hash_lookup(command);
 }
 
 int execute_external(command_t *cmd) {
@@ -149,398 +79,470 @@ int execute_external(command_t *cmd) {
         return 127;
     }
 
-    pid_t pid = fork();
-    
-    if (pid == -1) {
-        perror("fork");
-        free(full_path);
+    // Команда - задание из одного процесса в своей группе
+    pipeline_t single = {.stages = &cmd, .stage_count = 1, .capacity = 1};
+    job_t *job = job_create(&single);
+    if (job == NULL) {
         return 1;
-    } else if (pid == 0) {
-        // Дочерний процесс
-        
-        // ПРИМЕНЯЕМ ПЕРЕНАПРАВЛЕНИЯ
-        if (apply_redirections(cmd) < 0) {
-            fprintf(stderr, "Error: failed to apply redirections\n");
-            free(full_path);
-            exit(1);
-        }
-        
-        execv(full_path, cmd->words);
-        
-        // Если execv вернул управление - произошла ошибка
-        perror("execv");
-        free(full_path);
-        exit(1);
-    } else {
-        // Родительский процесс
-        free(full_path);
-        
-        if (!cmd->fonius) {
-            int status;
-            waitpid(pid, &status, 0);
-            return WEXITSTATUS(status);
-        } else {
-            printf("[%d] Started in fonius\n", pid);
-            return 0;
+    }
+
+    // Запуск через posix_spawn или fork, в зависимости от set -o spawn
+    pid_t pid = launch_command(cmd, full_path, -1, -1, job_launch_pgid(job));
+    if (pid == -1 || job_add_process(job, pid) < 0) {
+        if (pid != -1) {
+            waitpid(pid, NULL, 0);
         }
+        job_discard(job);
+        return 1;
     }
+
+    return job_run_foreground(job, 1);
 }
 
-// Вспомогательная функция для разделения конвейера на команды
-command_t **split_pipeline(command_t *cmd, int *cmd_count) {
-    // Считаем количество команд в конвейере
-    *cmd_count = 1;
-    for (int i = 0; i < cmd->word_num; i++) {
-        if (strcmp(cmd->words[i], "|") == 0) {
-            (*cmd_count)++;
+// Встроенная стадия конвейера, выполняемая в потоке shell. Поток
+// владеет своими концами pipe'ов и закрывает их, когда команда
+// завершилась: читатель получает EOF, писатель - EPIPE.
+typedef struct {
+    const builtin_t *builtin;
+    char **words;
+    int in_fd;          // Читающий конец pipe'а или -1 (stdin shell)
+    int out_fd;         // Пишущий конец pipe'а или -1 (stdout shell)
+    int status;
+    pthread_t thread;
+} stage_thread_t;
+
+static void *stage_thread_main(void *arg) {
+    stage_thread_t *stage = arg;
+    builtin_io_t io = {stage->in_fd >= 0 ? stage->in_fd : STDIN_FILENO, stdout};
+
+    if (stage->out_fd >= 0 && (io.out = fdopen(stage->out_fd, "w")) == NULL) {
+        perror("fdopen");
+        close(stage->out_fd);
+        stage->status = 1;
+    } else {
+        stage->status = run_builtin_thread(stage->builtin, stage->words, &io);
+        if (io.out != stdout) {
+            fclose(io.out);
         }
     }
 
-    // Выделяем память для массива команд
-    command_t **commands = malloc(*cmd_count * sizeof(command_t *));
-    if (commands == NULL) {
-        perror("malloc");
-        return NULL;
+    if (stage->in_fd >= 0) {
+        close(stage->in_fd);
     }
+    return NULL;
+}
 
-    int start = 0;
-    int cmd_index = 0;
-
-    for (int i = 0; i <= cmd->word_num; i++) {
-        // Нашли разделитель или конец массива
-        if (i == cmd->word_num || strcmp(cmd->words[i], "|") == 0) {
-            // Создаем новую команду
-            command_t *new_cmd = malloc(sizeof(command_t));
-            if (new_cmd == NULL) {
-                perror("malloc");
-                // Освобождаем уже созданные команды
-                for (int j = 0; j < cmd_index; j++) {
-                    free_command(commands[j]);
-                }
-                free(commands);
-                return NULL;
-            }
-
-            // Инициализируем команду
-            new_cmd->words = NULL;
-            new_cmd->word_num = i - start;
-            new_cmd->fonius = 0;
-            new_cmd->input_file = NULL;
-            new_cmd->output_file = NULL;
-            new_cmd->error_file = NULL;
-            new_cmd->append_output = 0;
-            new_cmd->append_error = 0;
-            new_cmd->merge_output = 0;
-            new_cmd->pipeline = NULL;
-            new_cmd->pipeline_count = 0;
-
-            // Копируем токены для этой команды
-            if (new_cmd->word_num > 0) {
-                new_cmd->words = malloc((new_cmd->word_num + 1) * sizeof(char *));
-                if (new_cmd->words == NULL) {
-                    perror("malloc");
-                    free(new_cmd);
-                    for (int j = 0; j < cmd_index; j++) {
-                        free_command(commands[j]);
-                    }
-                    free(commands);
-                    return NULL;
-                }
-
-                for (int j = 0; j < new_cmd->word_num; j++) {
-                    new_cmd->words[j] = strdup(cmd->words[start + j]);
-                    if (new_cmd->words[j] == NULL) {
-                        perror("strdup");
-                        for (int k = 0; k < j; k++) {
-                            free(new_cmd->words[k]);
-                        }
-                        free(new_cmd->words);
-                        free(new_cmd);
-                        for (int k = 0; k < cmd_index; k++) {
-                            free_command(commands[k]);
-                        }
-                        free(commands);
-                        return NULL;
-                    }
-                }
-                new_cmd->words[new_cmd->word_num] = NULL;
-            }
+// Поток создаётся со всеми заблокированными сигналами: SIGCHLD
+// обрабатывает основной поток, а запись в закрытый pipe возвращает
+// EPIPE вместо SIGPIPE для всего shell
+static int start_stage_thread(stage_thread_t *stage) {
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&stage->thread, NULL, stage_thread_main, stage);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (err != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+        return -1;
+    }
+    return 0;
+}
 
-            commands[cmd_index++] = new_cmd;
-            start = i + 1;  // Пропускаем символ "|"
+// Завершение уже запущенных стадий, если конвейер не удалось достроить
+static void abort_pipeline(pid_t *pids, stage_thread_t **threads, int launched) {
+    for (int i = 0; i < launched; i++) {
+        if (threads[i] == NULL) {
+            kill(pids[i], SIGTERM);
+        }
+    }
+    for (int i = 0; i < launched; i++) {
+        if (threads[i] != NULL) {
+            pthread_join(threads[i]->thread, NULL);
+        } else {
+            waitpid(pids[i], NULL, 0);
         }
     }
-
-    return commands;
 }
 
-int execute_pipeline(command_t *cmd) {
-    int cmd_count;
-    command_t **commands = split_pipeline(cmd, &cmd_count);
-    
-    if (commands == NULL) {
-        return 1;
+// Может ли стадия выполняться в потоке: у потока нет своих
+// дескрипторов, поэтому допустимо только чтение первой стадии из файла
+// (так её оставляет оптимизатор после cat файл |). Первая стадия без
+// перенаправления читала бы stdin shell: с терминала поток shell не в
+// группе переднего плана получит EIO, поэтому тогда нужен процесс.
+static int thread_stage_redirects(const command_t *cmd, int index) {
+    if (cmd->redirect_count == 0) {
+        return index > 0 || !isatty(STDIN_FILENO);
     }
+    const redirect_t *r = &cmd->redirects[0];
+    return index == 0 && cmd->redirect_count == 1 && r->op == REDIR_OPEN &&
+           r->fd == STDIN_FILENO && r->flags == O_RDONLY;
+}
 
-    if (cmd_count < 2) {
-        fprintf(stderr, "Invalid pipeline: need at least 2 commands\n");
-        for (int i = 0; i < cmd_count; i++) {
-            free_command(commands[i]);
-        }
-        free(commands);
-        return 1;
+// Запуск конвейера за линейное число системных вызовов. Каждый pipe
+// создаётся с O_CLOEXEC непосредственно перед запуском стадии, которая
+// в него пишет, а родитель сразу закрывает концы, переданные потомкам:
+// в любой момент у него открыто не больше трёх дескрипторов конвейера.
+// Потомкам не нужно обходить чужие pipe'ы - их закрывает exec
+// (или close_range после fork).
+//
+// Встроенные команды с флагом BUILTIN_THREAD и без перенаправлений
+// выполняются в потоках shell (set -o threads), остальные - в потомках.
+// Так же выполняются стадии grep -F, wc -l, head и tail (filters.c,
+// set -o filters).
+static int run_pipeline(pipeline_t *pipeline) {
+    int cmd_count = pipeline->stage_count;
+
+    // Одиночная команда выполняется без конвейера
+    if (cmd_count == 1) {
+        return execute_command(pipeline->stages[0]);
     }
 
-    // Создаем массив pipe'ов
-    int (*pipefds)[2] = malloc((cmd_count - 1) * sizeof(int[2]));
-    if (pipefds == NULL) {
-        perror("malloc");
-        for (int i = 0; i < cmd_count; i++) {
-            free_command(commands[i]);
-        }
-        free(commands);
+    command_t **commands = pipeline->stages;
+
+    // Пути ко всем внешним командам находятся до первого запуска:
+    // отсутствующая команда не оставляет за собой полконвейера
+    char **paths = arena_alloc(line_arena, cmd_count * sizeof(char *));
+    pid_t *pids = arena_alloc(line_arena, cmd_count * sizeof(pid_t));
+    stage_thread_t **threads = arena_alloc(line_arena, cmd_count * sizeof(stage_thread_t *));
+    if (paths == NULL || pids == NULL || threads == NULL) {
         return 1;
     }
+    for (int i = 0; i < cmd_count; i++) {
+        paths[i] = NULL;
+        threads[i] = NULL;
+        if (commands[i]->word_num == 0) {
+            continue;
+        }
 
-    // Создаем все pipe'ы
-    for (int i = 0; i < cmd_count - 1; i++) {
-        if (pipe(pipefds[i]) == -1) {
-            perror("pipe");
-            // Закрываем уже созданные pipe'ы
-            for (int j = 0; j < i; j++) {
-                close(pipefds[j][0]);
-                close(pipefds[j][1]);
+        const builtin_t *builtin = find_builtin(commands[i]->words[0]);
+        if (builtin != NULL) {
+            if (opt_threads && (builtin->flags & BUILTIN_THREAD) &&
+                thread_stage_redirects(commands[i], i) &&
+                (threads[i] = arena_alloc(line_arena, sizeof(stage_thread_t))) != NULL) {
+                threads[i]->builtin = builtin;
+                threads[i]->words = commands[i]->words;
             }
-            free(pipefds);
-            for (int j = 0; j < cmd_count; j++) {
-                free_command(commands[j]);
-            }
-            free(commands);
-            return 1;
+            continue;
         }
-    }
 
-    // Массив для хранения PID'ов всех процессов
-    pid_t *pids = malloc(cmd_count * sizeof(pid_t));
-    if (pids == NULL) {
-        perror("malloc");
-        for (int i = 0; i < cmd_count - 1; i++) {
-            close(pipefds[i][0]);
-            close(pipefds[i][1]);
+        // Встроенные фильтры (grep -F, wc -l, head, tail) заменяют
+        // внешнюю программу, если стадия может стать потоком. Они
+        // включаются только set -o filters и не зависят от set -o
+        // threads: это замена программы, а не встроенной команды. Путь
+        // к программе всё равно нужен: если поток не создастся, стадия
+        // запустится как обычно.
+        const builtin_t *filter = NULL;
+        if (thread_stage_redirects(commands[i], i)) {
+            filter = find_filter(commands[i]->words);
         }
-        free(pipefds);
-        for (int i = 0; i < cmd_count; i++) {
-            free_command(commands[i]);
+        if (filter != NULL && (threads[i] = arena_alloc(line_arena, sizeof(stage_thread_t))) != NULL) {
+            threads[i]->builtin = filter;
+            threads[i]->words = commands[i]->words;
         }
-        free(commands);
+
+        paths[i] = get_full_path(commands[i]->words[0]);
+        if (paths[i] == NULL) {
+            fprintf(stderr, "%s: command not found\n", commands[i]->words[0]);
+            return 127;
+        }
+    }
+
+    // Внешние стадии - процессы одного задания
+    job_t *job = job_create(pipeline);
+    if (job == NULL) {
         return 1;
     }
 
-    // Создаем процессы для каждой команды
+    // Потомки, созданные fork, не должны повторно выводить буфер родителя
+    fflush(stdout);
+
+    int prev_read = -1;     // Читающий конец pipe'а от предыдущей стадии
     for (int i = 0; i < cmd_count; i++) {
-        pids[i] = fork();
-        
-        if (pids[i] == -1) {
-            perror("fork");
-            // Убиваем уже созданные процессы
-            for (int j = 0; j < i; j++) {
-                kill(pids[j], SIGTERM);
-            }
-            // Закрываем pipe'ы
-            for (int j = 0; j < cmd_count - 1; j++) {
-                close(pipefds[j][0]);
-                close(pipefds[j][1]);
-            }
-            free(pipefds);
-            free(pids);
-            for (int j = 0; j < cmd_count; j++) {
-                free_command(commands[j]);
-            }
-            free(commands);
+        int fds[2] = {-1, -1};
+        if (i < cmd_count - 1 && pipe2(fds, O_CLOEXEC) == -1) {
+            perror("pipe");
+            if (prev_read >= 0) close(prev_read);
+            abort_pipeline(pids, threads, i);
+            job_discard(job);
             return 1;
         }
 
-        if (pids[i] == 0) {
-            // Дочерний процесс
-            
-            // Подключаем вход
-            if (i > 0) {
-                dup2(pipefds[i-1][0], STDIN_FILENO);
-                close(pipefds[i-1][0]);
-            }
-            
-            // Подключаем выход
-            if (i < cmd_count - 1) {
-                dup2(pipefds[i][1], STDOUT_FILENO);
-                close(pipefds[i][1]);
-            }
-            
-            // Закрываем все pipe'ы в дочернем процессе
-            for (int j = 0; j < cmd_count - 1; j++) {
-                if (j != i - 1) close(pipefds[j][0]);
-                if (j != i) close(pipefds[j][1]);
+        // Файл ввода первой стадии открывает shell: у потока нет
+        // своего stdin. Если открыть не удалось, стадия запускается
+        // обычным путём и сообщает об ошибке сама.
+        if (threads[i] != NULL && commands[i]->redirect_count > 0) {
+            prev_read = open(commands[i]->redirects[0].path, O_RDONLY | O_CLOEXEC);
+            if (prev_read < 0) {
+                threads[i] = NULL;
             }
-            
-            // ПРИМЕНЯЕМ ПЕРЕНАПРАВЛЕНИЯ ДЛЯ ЭТОЙ КОМАНДЫ
-            if (apply_redirections(commands[i]) < 0) {
-                fprintf(stderr, "Error: failed to apply redirections for command %d\n", i);
-                exit(1);
+        }
+
+        // Концы pipe'ов переходят к потоку стадии
+        if (threads[i] != NULL) {
+            threads[i]->in_fd = prev_read;
+            threads[i]->out_fd = fds[1];
+            if (start_stage_thread(threads[i]) == 0) {
+                pids[i] = -1;
+                prev_read = fds[0];
+                continue;
             }
-            
-            // Выполняем команду
-            int result = execute_command(commands[i]);
-            
-            // Освобождаем память перед выходом
-            for (int j = 0; j < cmd_count; j++) {
-                if (j != i) free_command(commands[j]);
+            threads[i] = NULL;      // Выполнится в потомке
+            if (commands[i]->redirect_count > 0) {
+                close(prev_read);
+                prev_read = -1;
             }
-            free(commands);
-            free(pipefds);
-            free(pids);
-            
-            exit(result);
         }
-    }
 
-    // Родительский процесс - закрываем все pipe'ы
-    for (int i = 0; i < cmd_count - 1; i++) {
-        close(pipefds[i][0]);
-        close(pipefds[i][1]);
+        pids[i] = launch_command(commands[i], paths[i], prev_read, fds[1], job_launch_pgid(job));
+
+        // Переданные потомку концы родителю больше не нужны
+        if (prev_read >= 0) close(prev_read);
+        if (fds[1] >= 0) close(fds[1]);
+        prev_read = fds[0];
+
+        if (pids[i] == -1 || job_add_process(job, pids[i]) < 0) {
+            if (prev_read >= 0) close(prev_read);
+            abort_pipeline(pids, threads, pids[i] == -1 ? i : i + 1);
+            job_discard(job);
+            return 1;
+        }
     }
 
-    // Ожидаем завершения всех процессов
-    int last_status = 0;
+    // Ожидаем завершения всех стадий. Статус конвейера - статус
+    // последней стадии, будь то поток или процесс. Процессы ждёт
+    // задание: оно отдаёт им терминал и замечает Ctrl-Z. Конвейер с
+    // потоками shell остановить нельзя - потоки не уходят в фон.
+    int has_threads = 0;
     for (int i = 0; i < cmd_count; i++) {
-        int status;
-        waitpid(pids[i], &status, 0);
-        if (i == cmd_count - 1) {  // Сохраняем статус последней команды
-            last_status = WEXITSTATUS(status);
-        }
+        has_threads |= threads[i] != NULL;
     }
 
-    // Освобождаем память
-    free(pipefds);
-    free(pids);
+    int last_status = job_run_foreground(job, !has_threads);
     for (int i = 0; i < cmd_count; i++) {
-        free_command(commands[i]);
+        if (threads[i] != NULL) {
+            pthread_join(threads[i]->thread, NULL);
+        }
+    }
+    if (threads[cmd_count - 1] != NULL) {
+        last_status = threads[cmd_count - 1]->status;
     }
-    free(commands);
 
     return last_status;
 }
 
-// НОВАЯ ФУНКЦИЯ: Выполнение последовательности команд с учетом логики && и ||
-int execute_command_sequence(command_sequence_t *seq) {
-    if (seq == NULL || seq->command_count == 0) {
-        return 0;
-    }
-
-    // Если только одна команда - выполняем как обычно
-    if (seq->command_count == 1) {
-        return execute_command(seq->commands[0]);
-    }
+// Конвейер после оптимизатора (set -o optimize)
+int execute_pipeline(pipeline_t *pipeline) {
+    pipeline_t *plan = optimize_pipeline(pipeline);
+    int status = run_pipeline(plan);
+    return plan->force_success ? 0 : status;
+}
 
+// Выполнение связки конвейеров с учетом логики && и ||
+int execute_and_or(and_or_t *and_or) {
     int last_status = 0;
-    int should_execute_next = 1; // Флаг: нужно ли выполнять следующую команду
 
-    for (int i = 0; i < seq->command_count; i++) {
-        // Выполняем текущую команду только если нужно
-        int current_status = 0;
-        if (should_execute_next) {
-            current_status = execute_command(seq->commands[i]);
-        } else {
-            // Пропускаем выполнение, но сохраняем статус последней выполненной команды
-            current_status = last_status;
-        }
-        
-        last_status = current_status;
-        
-        // Определяем, нужно ли выполнять следующую команду
-        if (i < seq->command_count - 1) {
-            int separator = seq->separators[i];
-            
+    for (int i = 0; i < and_or->count; i++) {
+        // Определяем, нужно ли выполнять очередной конвейер
+        if (i > 0) {
+            int separator = and_or->connectors[i];
+
             switch (separator) {
-                case 0: // ; - ВСЕГДА выполняем следующую команду
-                    should_execute_next = 1;
+                case 1: // && - выполняем только если УСПЕХ (status == 0)
+                    if (last_status != 0) continue;
                     break;
                     
-                case 1: // && - выполняем следующую только если УСПЕХ (status == 0)
-                    should_execute_next = (current_status == 0);
-                    break;
-                    
-                case 2: // || - выполняем следующую только если ОШИБКА (status != 0)
-                    should_execute_next = (current_status != 0);
+                case 2: // || - выполняем только если ОШИБКА (status != 0)
+                    if (last_status == 0) continue;
                     break;
                     
                 default:
                     fprintf(stderr, "Unknown separator type: %d\n", separator);
-                    should_execute_next = 1;
                     break;
             }
         }
+
+        // Пропущенный конвейер сохраняет статус последнего выполненного
+        last_status = execute_pipeline(and_or->pipelines[i]);
     }
 
     return last_status;
 }
 
-int execute_command(command_t *cmd) {
-    if (cmd == NULL || cmd->word_num == 0) {
-        return 0;
-    }
-
-    // Проверяем на наличие разделителей команд в самой команде
-    int has_separators = 0;
-    for (int i = 0; i < cmd->word_num; i++) {
-        if (is_command_separator(cmd->words[i])) {
-            has_separators = 1;
-            break;
+// Запуск фонового задания для связки с &. Одиночная внешняя команда
+// запускается сама, без копии shell. Всё остальное - конвейеры, связки
+// через && и ||, встроенные команды - выполняет дочерний shell в своей
+// группе процессов. Вызывается и для заданий из очереди, поэтому путь
+// к команде ищется здесь, а не при постановке в очередь.
+int launch_background(job_t *job, and_or_t *and_or) {
+    command_t *single = NULL;
+    if (and_or->count == 1 && and_or->pipelines[0]->stage_count == 1) {
+        command_t *cmd = and_or->pipelines[0]->stages[0];
+        if (cmd->word_num > 0 && cmd->fonius && find_builtin(cmd->words[0]) == NULL) {
+            single = cmd;
         }
     }
-    
-    if (has_separators) {
-        // Перестраиваем исходную строку для парсинга последовательности
-        char *reconstructed_input = malloc(MAX_INPUT_LENGTH);
-        if (reconstructed_input == NULL) {
-            perror("malloc");
+
+    pid_t pgid = job_launch_pgid(job);
+    pid_t pid;
+    if (single != NULL) {
+        char *full_path = get_full_path(single->words[0]);
+        if (full_path == NULL) {
+            fprintf(stderr, "%s: command not found\n", single->words[0]);
+            job_discard(job);
+            return 127;
+        }
+        pid = launch_command(single, full_path, -1, -1, pgid);
+        if (pid == -1) {
+            job_discard(job);
             return 1;
         }
-        
-        reconstructed_input[0] = '\0';
-        
-        // Собираем исходную строку из слов команды
-        for (int j = 0; j < cmd->word_num; j++) {
-            if (j > 0) {
-                strcat(reconstructed_input, " ");
+    } else {
+        // Дочерний shell не должен повторно выводить буфер родителя
+        fflush(stdout);
+        fflush(stderr);
+
+        pid = fork();
+        if (pid == -1) {
+            perror("fork");
+            job_discard(job);
+            return 1;
+        } else if (pid == 0) {
+            if (pgid >= 0) {
+                setpgid(0, pgid);
             }
-            strcat(reconstructed_input, cmd->words[j]);
+            jobs_enter_subshell();
+
+            int status = execute_and_or(and_or);
+            fflush(stdout);
+            fflush(stderr);
+            // _exit: обработчики atexit (история, терминал) принадлежат родителю
+            _exit(status);
         }
-        
-        // Парсим как последовательность команд
-        command_sequence_t *seq = parse_input_with_separators(reconstructed_input);
-        free(reconstructed_input);
-        
-        if (seq != NULL) {
-            int result = execute_command_sequence(seq);
-            free_command_sequence(seq);
-            return result;
+    }
+
+    if (job_add_process(job, pid) < 0) {
+        waitpid(pid, NULL, 0);
+        job_discard(job);
+        return 1;
+    }
+    job_run_background(job);
+    return 0;
+}
+
+// Связка с &: фоновое задание сразу или, если слоты заняты
+// (set -o maxjobs), в очередь. Приглашение возвращается сразу.
+static int execute_background(command_list_t *list, and_or_t *and_or) {
+    job_t *job = job_create_list(and_or);
+    if (job == NULL) {
+        return 1;
+    }
+    if (job_should_queue()) {
+        job_enqueue(job, list, and_or);
+        return 0;
+    }
+    return launch_background(job, and_or);
+}
+
+// Выполнение разобранной строки: связки через ; выполняются всегда,
+// связки с & - в фоне
+int execute_command_list(command_list_t *list) {
+    if (list == NULL) {
+        return 0;
+    }
+
+    int last_status = 0;
+    for (int i = 0; i < list->count; i++) {
+        and_or_t *and_or = list->lists[i];
+        last_status = and_or->fonius ? execute_background(list, and_or) : execute_and_or(and_or);
+    }
+    return last_status;
+}
+
+// Сохранённый дескриптор на время перенаправлений встроенной команды
+typedef struct {
+    int fd;
+    int saved;      // Копия с FD_CLOEXEC или -1, если fd был закрыт
+} saved_fd_t;
+
+static void restore_fds(saved_fd_t *saved, int count) {
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = count - 1; i >= 0; i--) {
+        if (saved[i].saved >= 0) {
+            dup2(saved[i].saved, saved[i].fd);
+            close(saved[i].saved);
         } else {
-            return 1; // Ошибка парсинга
+            close(saved[i].fd);
         }
     }
+}
 
-    // Проверяем на конвейер
-    for (int i = 0; i < cmd->word_num; i++) {
-        if (strcmp(cmd->words[i], "|") == 0) {
-            return execute_pipeline(cmd);
+// Встроенная команда с перенаправлениями в процессе shell: затронутые
+// дескрипторы сохраняются через F_DUPFD_CLOEXEC, перенаправления
+// применяются как в потомке, а после команды дескрипторы возвращаются.
+// builtin == NULL - команда из одних перенаправлений (> file): файлы
+// открываются и создаются, но команды нет.
+static int run_builtin_redirected(const builtin_t *builtin, command_t *cmd) {
+    if (cmd->redirect_count == 0) {
+        return builtin != NULL ? run_builtin(builtin, cmd->words) : 0;
+    }
+
+    saved_fd_t *saved = arena_alloc(line_arena, cmd->redirect_count * sizeof(saved_fd_t));
+    if (saved == NULL) {
+        return 1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        int fd = cmd->redirects[i].fd;
+        int seen = 0;
+        for (int j = 0; j < count && !seen; j++) {
+            seen = (saved[j].fd == fd);
+        }
+        if (seen) {
+            continue;
         }
+
+        saved[count].fd = fd;
+        saved[count].saved = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+        if (saved[count].saved < 0 && errno != EBADF) {
+            perror("fcntl");
+            restore_fds(saved, count);
+            return 1;
+        }
+        count++;
     }
 
-    // Проверяем встроенные команды
-    int builtin_result = execute_bash_cmd(cmd->words);
-    if (builtin_result != -1) {
-        return builtin_result;
+    // Буферы stdio относятся к прежним дескрипторам
+    fflush(stdout);
+    fflush(stderr);
+
+    if (apply_redirections(cmd) < 0) {
+        restore_fds(saved, count);
+        return 1;
+    }
+
+    int result = builtin != NULL ? run_builtin(builtin, cmd->words) : 0;
+    restore_fds(saved, count);
+    return result;
+}
+
+// Выполнение простой команды
+int execute_command(command_t *cmd) {
+    if (cmd == NULL) {
+        return 0;
+    }
+    if (cmd->word_num == 0) {
+        return run_builtin_redirected(NULL, cmd);
+    }
+
+    // Встроенные команды выполняются без fork, с перенаправлениями
+    const builtin_t *builtin = find_builtin(cmd->words[0]);
+    if (builtin != NULL) {
+        return run_builtin_redirected(builtin, cmd);
     }
 
     // Внешние команды
     return execute_external(cmd);
-}
\ No newline at end of file
+}
@@ -0,0 +1,503 @@
+#define _GNU_SOURCE
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+
+// Общий индекс исполняемых файлов PATH: имя -> каталог, с временами
+// изменения каталогов. Лежит в $XDG_RUNTIME_DIR (или /dev/shm) в файле,
+// привязанном к пользователю и значению PATH. Каждый новый shell
+// отображает его только для чтения и находит команды без обхода
+// каталогов; отсутствие имени в свежем индексе означает, что команды нет.
+//
+// Если время изменения какого-либо каталога не совпадает с записанным,
+// любой shell перестраивает индекс: пишет временный файл и атомарно
+// заменяет старый через rename. Уже отображённые копии остаются целыми.
+
+#define EXE_INDEX_MAGIC "SHRXIDX1"
+#define EXE_INDEX_VERSION 1
+#define EXE_INDEX_RECHECK 2          // Секунд между проверками каталогов
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t dir_count;
+    uint32_t entry_count;
+    uint32_t bucket_count;       // Степень двойки
+    uint64_t path_hash;          // FNV-1a значения PATH
+    uint32_t strings_offset;
+    uint32_t strings_size;
+    uint32_t total_size;
+    uint32_t reserved;
+} index_header_t;
+
+typedef struct {
+    uint32_t name_off;           // Смещение имени каталога в строках
+    uint32_t reserved;
+    int64_t mtime_sec;           // 0 - каталога не было при построении
+    int64_t mtime_nsec;
+    uint64_t dev;
+    uint64_t ino;
+} index_dir_t;
+
+typedef struct {
+    uint32_t name_off;
+    uint32_t dir;                // Номер каталога
+    uint32_t next;               // Следующая запись корзины + 1 (0 - конец)
+    uint32_t hash;
+} index_entry_t;
+
+// Текущее отображение
+static const unsigned char *map = NULL;
+static size_t map_size = 0;
+static uint64_t map_path_hash = 0;
+static time_t last_check = 0;
+static int disabled = 0;             // Нет подходящего каталога для файла
+static exe_index_stats_t stats;
+
+static uint64_t fnv1a(const char *s) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static const index_header_t *header(void) {
+    return (const index_header_t *)map;
+}
+
+static const index_dir_t *dirs(void) {
+    return (const index_dir_t *)(map + sizeof(index_header_t));
+}
+
+static const uint32_t *buckets(void) {
+    return (const uint32_t *)(dirs() + header()->dir_count);
+}
+
+static const index_entry_t *entries(void) {
+    return (const index_entry_t *)(buckets() + header()->bucket_count);
+}
+
+static const char *string_at(uint32_t off) {
+    if (off >= header()->strings_size) {
+        return "";
+    }
+    return (const char *)map + header()->strings_offset + off;
+}
+
+// Имя файла индекса для данного PATH
+static int index_file_name(char *buf, size_t size, uint64_t path_hash) {
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    if (dir == NULL || dir[0] == '\0' || access(dir, W_OK) != 0) {
+        dir = "/dev/shm";
+        if (access(dir, W_OK) != 0) {
+            return -1;
+        }
+    }
+
+    int written = snprintf(buf, size, "%s/myshell-exeindex-%u-%016llx",
+                           dir, (unsigned)getuid(), (unsigned long long)path_hash);
+    return (written < 0 || (size_t)written >= size) ? -1 : 0;
+}
+
+void exe_index_close(void) {
+    if (map != NULL) {
+        munmap((void *)map, map_size);
+        map = NULL;
+        map_size = 0;
+    }
+}
+
+// Совпадают ли каталоги индекса с элементами PATH по порядку. Пропуски
+// те же, что при построении: пустые и слишком длинные элементы.
+static int dirs_match_path(const char *path_env) {
+    const index_header_t *h = header();
+    uint32_t index = 0;
+
+    const char *dir = path_env;
+    while (1) {
+        const char *colon = strchr(dir, ':');
+        size_t len = colon ? (size_t)(colon - dir) : strlen(dir);
+
+        if (len > 0 && len < MAX_PATH_LENGTH) {
+            if (index >= h->dir_count) {
+                return 0;
+            }
+            const char *name = string_at(dirs()[index].name_off);
+            if (strlen(name) != len || memcmp(name, dir, len) != 0) {
+                return 0;
+            }
+            index++;
+        }
+
+        if (colon == NULL) break;
+        dir = colon + 1;
+    }
+    return index == h->dir_count;
+}
+
+// Проверка, что отображённый файл целиком укладывается в свой размер,
+// строки не выходят за его конец, а каталоги - те же, что в PATH
+static int index_valid(const char *path_env, uint64_t path_hash) {
+    if (map_size < sizeof(index_header_t)) {
+        return 0;
+    }
+    const index_header_t *h = header();
+    if (memcmp(h->magic, EXE_INDEX_MAGIC, 8) != 0 || h->version != EXE_INDEX_VERSION ||
+        h->path_hash != path_hash || h->total_size != map_size ||
+        h->bucket_count == 0 || (h->bucket_count & (h->bucket_count - 1)) != 0) {
+        return 0;
+    }
+
+    size_t tables = sizeof(index_header_t) + (size_t)h->dir_count * sizeof(index_dir_t) +
+                    (size_t)h->bucket_count * sizeof(uint32_t) +
+                    (size_t)h->entry_count * sizeof(index_entry_t);
+    if (tables > h->strings_offset ||
+        (size_t)h->strings_offset + h->strings_size > map_size) {
+        return 0;
+    }
+    if (h->strings_size > 0 && map[h->strings_offset + h->strings_size - 1] != '\0') {
+        return 0;
+    }
+    return dirs_match_path(path_env);
+}
+
+// Отображение файла индекса. Файл в общем каталоге (/dev/shm) мог
+// подложить другой пользователь, поэтому принимается только свой
+// обычный файл, в который не могут писать группа и остальные.
+static int map_index(const char *file, const char *path_env, uint64_t path_hash) {
+    int fd = open(file, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid() ||
+        (st.st_mode & (S_IWGRP | S_IWOTH)) != 0 || st.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+
+    void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return -1;
+    }
+
+    exe_index_close();
+    map = mem;
+    map_size = st.st_size;
+    if (!index_valid(path_env, path_hash)) {
+        exe_index_close();
+        return -1;
+    }
+    map_path_hash = path_hash;
+    return 0;
+}
+
+// Совпадают ли времена изменения каталогов с записанными в индексе
+static int index_fresh(void) {
+    const index_header_t *h = header();
+    for (uint32_t i = 0; i < h->dir_count; i++) {
+        const index_dir_t *d = &dirs()[i];
+        struct stat st;
+        if (stat(string_at(d->name_off), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            if (d->mtime_sec != 0) return 0;
+            continue;
+        }
+        if (d->mtime_sec != (int64_t)st.st_mtim.tv_sec ||
+            d->mtime_nsec != (int64_t)st.st_mtim.tv_nsec ||
+            d->dev != (uint64_t)st.st_dev || d->ino != (uint64_t)st.st_ino) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Растущий буфер построения во временной арене строки
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} build_buf_t;
+
+static int buf_reserve(build_buf_t *b, size_t extra) {
+    if (b->len + extra <= b->cap) {
+        return 0;
+    }
+    size_t new_cap = b->cap > 0 ? b->cap * 2 : 4096;
+    while (new_cap < b->len + extra) {
+        new_cap *= 2;
+    }
+    unsigned char *grown = arena_realloc(line_arena, b->data, b->cap, new_cap);
+    if (grown == NULL) {
+        return -1;
+    }
+    b->data = grown;
+    b->cap = new_cap;
+    return 0;
+}
+
+static int buf_add_string(build_buf_t *b, const char *s, size_t len, uint32_t *off) {
+    if (buf_reserve(b, len + 1) < 0) {
+        return -1;
+    }
+    *off = b->len;
+    memcpy(b->data + b->len, s, len);
+    b->data[b->len + len] = '\0';
+    b->len += len + 1;
+    return 0;
+}
+
+static int buf_add(build_buf_t *b, const void *item, size_t size) {
+    if (buf_reserve(b, size) < 0) {
+        return -1;
+    }
+    memcpy(b->data + b->len, item, size);
+    b->len += size;
+    return 0;
+}
+
+// Построение индекса: каталоги PATH читаются по порядку, первое
+// вхождение имени выигрывает, как при обычном поиске
+static int build_index(const char *path_env, uint64_t path_hash, const char *file) {
+    build_buf_t dir_buf = {0}, entry_buf = {0}, strings = {0};
+    uint32_t dir_count = 0;
+
+    const char *dir = path_env;
+    while (1) {
+        const char *colon = strchr(dir, ':');
+        size_t len = colon ? (size_t)(colon - dir) : strlen(dir);
+
+        if (len > 0 && len < MAX_PATH_LENGTH) {
+            char dir_path[MAX_PATH_LENGTH];
+            memcpy(dir_path, dir, len);
+            dir_path[len] = '\0';
+
+            index_dir_t d;
+            memset(&d, 0, sizeof(d));
+            if (buf_add_string(&strings, dir_path, len, &d.name_off) < 0) {
+                return -1;
+            }
+
+            // Время изменения берётся до чтения: изменение во время
+            // чтения сделает индекс устаревшим при следующей проверке
+            struct stat st;
+            DIR *dp = NULL;
+            if (stat(dir_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+                d.mtime_sec = st.st_mtim.tv_sec;
+                d.mtime_nsec = st.st_mtim.tv_nsec;
+                d.dev = st.st_dev;
+                d.ino = st.st_ino;
+                dp = opendir(dir_path);
+            }
+
+            struct dirent *de;
+            while (dp != NULL && (de = readdir(dp)) != NULL) {
+                if (de->d_name[0] == '.' || de->d_type == DT_DIR) {
+                    continue;
+                }
+                index_entry_t e;
+                e.dir = dir_count;
+                e.next = 0;
+                e.hash = (uint32_t)fnv1a(de->d_name);
+                if (buf_add_string(&strings, de->d_name, strlen(de->d_name), &e.name_off) < 0 ||
+                    buf_add(&entry_buf, &e, sizeof(e)) < 0) {
+                    closedir(dp);
+                    return -1;
+                }
+            }
+            if (dp != NULL) {
+                closedir(dp);
+            }
+
+            if (buf_add(&dir_buf, &d, sizeof(d)) < 0) {
+                return -1;
+            }
+            dir_count++;
+        }
+
+        if (colon == NULL) break;
+        dir = colon + 1;
+    }
+
+    // Корзины: записи вставляются с конца, чтобы в цепочке первым шло
+    // вхождение из более раннего каталога
+    uint32_t entry_count = entry_buf.len / sizeof(index_entry_t);
+    uint32_t bucket_count = 64;
+    while (bucket_count < entry_count) {
+        bucket_count *= 2;
+    }
+    uint32_t *bucket_table = arena_calloc(line_arena, bucket_count * sizeof(uint32_t));
+    if (bucket_table == NULL) {
+        return -1;
+    }
+    index_entry_t *e = (index_entry_t *)entry_buf.data;
+    for (uint32_t i = entry_count; i-- > 0; ) {
+        uint32_t b = e[i].hash & (bucket_count - 1);
+        e[i].next = bucket_table[b];
+        bucket_table[b] = i + 1;
+    }
+
+    index_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, EXE_INDEX_MAGIC, 8);
+    h.version = EXE_INDEX_VERSION;
+    h.dir_count = dir_count;
+    h.entry_count = entry_count;
+    h.bucket_count = bucket_count;
+    h.path_hash = path_hash;
+    h.strings_offset = sizeof(h) + dir_buf.len + bucket_count * sizeof(uint32_t) + entry_buf.len;
+    h.strings_size = strings.len;
+    h.total_size = h.strings_offset + strings.len;
+
+    // Запись во временный файл и атомарная замена. mkostemp создаёт
+    // новый файл с правами 0600 (O_EXCL): чужой файл или ссылка с тем
+    // же именем не будут перезаписаны.
+    char tmp[MAX_PATH_LENGTH + 32];
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", file);
+    int fd = mkostemp(tmp, O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    const void *parts[] = {&h, dir_buf.data, bucket_table, entry_buf.data, strings.data};
+    size_t sizes[] = {sizeof(h), dir_buf.len, bucket_count * sizeof(uint32_t),
+                      entry_buf.len, strings.len};
+    for (int i = 0; i < 5; i++) {
+        const char *p = parts[i];
+        size_t left = sizes[i];
+        while (left > 0) {
+            ssize_t n = write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                close(fd);
+                unlink(tmp);
+                return -1;
+            }
+            p += n;
+            left -= n;
+        }
+    }
+    close(fd);
+
+    if (rename(tmp, file) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    stats.rebuilds++;
+    return 0;
+}
+
+// Открытие индекса для текущего PATH; устаревший или отсутствующий
+// индекс перестраивается
+static int ensure_index(const char *path_env) {
+    if (disabled) {
+        return -1;
+    }
+
+    uint64_t path_hash = fnv1a(path_env);
+    time_t now = time(NULL);
+    if (map != NULL && map_path_hash == path_hash && now - last_check < EXE_INDEX_RECHECK) {
+        return 0;
+    }
+
+    char file[MAX_PATH_LENGTH];
+    if (index_file_name(file, sizeof(file), path_hash) < 0) {
+        disabled = 1;
+        return -1;
+    }
+
+    // Индекс прежнего PATH закрывается сразу: если файла для нового PATH
+    // ещё нет, map_index не заменит отображение, и поиск шёл бы по
+    // чужим каталогам
+    if (map == NULL || map_path_hash != path_hash) {
+        exe_index_close();
+        map_index(file, path_env, path_hash);
+    }
+    last_check = now;
+
+    if (map != NULL && map_path_hash == path_hash && index_fresh()) {
+        return 0;
+    }
+
+    // Индекс мог уже перестроить другой shell
+    if (map_index(file, path_env, path_hash) == 0 && index_fresh()) {
+        return 0;
+    }
+
+    exe_index_close();
+    if (build_index(path_env, path_hash, file) < 0 || map_index(file, path_env, path_hash) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Открытие индекса при запуске shell
+void exe_index_open(void) {
+    const char *path_env = getenv("PATH");
+    if (path_env != NULL) {
+        ensure_index(path_env);
+    }
+}
+
+// Следующий поиск заново сверит каталоги с индексом
+void exe_index_recheck(void) {
+    last_check = 0;
+}
+
+// Поиск команды в индексе. 1 - найдена (путь в *found, во временной
+// арене строки), 0 - в свежем индексе её нет, -1 - индекс не помог.
+int exe_index_lookup(const char *command, const char *path_env, char **found) {
+    if (ensure_index(path_env) < 0) {
+        return -1;
+    }
+
+    uint32_t hash = (uint32_t)fnv1a(command);
+    const index_header_t *h = header();
+    uint32_t i = buckets()[hash & (h->bucket_count - 1)];
+
+    // Не больше entry_count шагов: испорченный файл с циклом в цепочке
+    // не должен подвесить shell
+    for (uint32_t steps = 0; i != 0 && i <= h->entry_count && steps < h->entry_count; steps++) {
+        const index_entry_t *e = &entries()[i - 1];
+        if (e->hash == hash && e->dir < h->dir_count && strcmp(string_at(e->name_off), command) == 0) {
+            const char *dir = string_at(dirs()[e->dir].name_off);
+            size_t dir_len = strlen(dir);
+            size_t cmd_len = strlen(command);
+            char *path = arena_alloc(line_arena, dir_len + cmd_len + 2);
+            if (path == NULL) {
+                return -1;
+            }
+            memcpy(path, dir, dir_len);
+            path[dir_len] = '/';
+            memcpy(path + dir_len + 1, command, cmd_len + 1);
+
+            // Одна проверка вместо обхода: файл может быть неисполняемым
+            if (access(path, X_OK) != 0) {
+                return -1;
+            }
+            stats.hits++;
+            *found = path;
+            return 1;
+        }
+        i = e->next;
+    }
+
+    stats.negative_hits++;
+    return 0;
+}
+
+void get_exe_index_stats(exe_index_stats_t *out) {
+    *out = stats;
+    out->mapped = map != NULL;
+    out->entries = map != NULL ? (int)header()->entry_count : 0;
+    out->dirs = map != NULL ? (int)header()->dir_count : 0;
+}
@@ -0,0 +1,657 @@
+#define _GNU_SOURCE
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// Встроенные фильтры для хвостов конвейеров: grep -F, wc -l, head -n,
+// tail -n. Стадия конвейера с таким фильтром выполняется в потоке shell
+// (как BUILTIN_THREAD), без fork и exec. Данные читаются большими
+// блоками, а строки ищутся memchr/memmem по всему блоку сразу: в glibc
+// это векторные реализации, и на строку не приходится ни одного вызова.
+//
+// Фильтр берётся только для вариантов вызова, которые он повторяет
+// байт в байт (текстовый ввод, локаль C): иначе стадия запускает
+// настоящую программу. Выключается через set +o filters.
+//
+// Локаль важна только для grep: в многобайтовой локали GNU grep
+// считает ввод с неверной последовательностью байтов двоичным. wc -l,
+// head -n и tail -n считают байты '\n' в любой локали.
+
+#define FILTER_BUF_SIZE (128 * 1024)
+#define SIGPIPE_STATUS (128 + 13)     // Как у coreutils, убитых SIGPIPE
+
+// Разобранные аргументы фильтра
+typedef struct {
+    const char *pattern;    // grep: строка поиска
+    size_t pattern_len;
+    int invert;             // grep -v
+    int count;              // grep -c
+    long long lines;        // head/tail: число строк
+    int from_start;         // tail -n +N: с N-й строки
+    const char *file;       // Единственный файл или NULL (stdin)
+} filter_args_t;
+
+// Буфер чтения: в начале лежит незаконченная строка прошлого блока
+typedef struct {
+    int fd;
+    char *buf;
+    size_t size;
+    size_t len;
+    int eof;
+} line_reader_t;
+
+// Разбор числа строк для head/tail: только десятичные цифры
+static int parse_count(const char *s, long long *out) {
+    if (*s == '\0') {
+        return -1;
+    }
+    long long n = 0;
+    for (; *s; s++) {
+        if (*s < '0' || *s > '9' || n > 1000000000000LL) {
+            return -1;
+        }
+        n = n * 10 + (*s - '0');
+    }
+    *out = n;
+    return 0;
+}
+
+// Остаток аргументов после опций: не больше одного файла
+static int parse_file(char **args, filter_args_t *fa) {
+    if (args[0] == NULL) {
+        return 0;
+    }
+    if (args[1] != NULL) {
+        return -1;              // Несколько файлов - заголовки и префиксы
+    }
+    fa->file = strcmp(args[0], "-") == 0 ? NULL : args[0];
+    return 0;
+}
+
+// grep [-F] [-v] [-c] [--] строка [файл]. Без -F строка не должна
+// содержать символов BRE, тогда поиск регулярного выражения и
+// подстроки совпадают.
+static int parse_grep(char **args, filter_args_t *fa) {
+    int fixed = 0;
+    int i = 1;
+
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        }
+        for (const char *o = args[i] + 1; *o; o++) {
+            if (*o == 'F') fixed = 1;
+            else if (*o == 'v') fa->invert = 1;
+            else if (*o == 'c') fa->count = 1;
+            else return -1;
+        }
+    }
+
+    if (args[i] == NULL) {
+        return -1;
+    }
+    fa->pattern = args[i];
+    fa->pattern_len = strlen(args[i]);
+    if (strchr(fa->pattern, '\n') != NULL) {
+        return -1;              // Несколько шаблонов
+    }
+    if (!fixed && strpbrk(fa->pattern, ".[]*^$\\") != NULL) {
+        return -1;
+    }
+    return parse_file(args + i + 1, fa);
+}
+
+// wc -l [файл]
+static int parse_wc(char **args, filter_args_t *fa) {
+    if (args[1] == NULL || strcmp(args[1], "-l") != 0) {
+        return -1;
+    }
+    return parse_file(args + 2, fa);
+}
+
+// head/tail [-n [+]N | -nN | -N] [файл]
+static int parse_lines(char **args, filter_args_t *fa, int allow_plus) {
+    int i = 1;
+    const char *count = NULL;
+
+    fa->lines = 10;
+    if (args[i] != NULL && strcmp(args[i], "-n") == 0) {
+        if (args[i + 1] == NULL) return -1;
+        count = args[i + 1];
+        i += 2;
+    } else if (args[i] != NULL && strncmp(args[i], "-n", 2) == 0) {
+        count = args[i] + 2;
+        i++;
+    } else if (args[i] != NULL && args[i][0] == '-' && args[i][1] >= '0' && args[i][1] <= '9') {
+        count = args[i] + 1;
+        i++;
+    }
+
+    if (count != NULL) {
+        if (allow_plus && count[0] == '+') {
+            fa->from_start = 1;
+            count++;
+        }
+        if (parse_count(count, &fa->lines) < 0) {
+            return -1;
+        }
+    }
+    if (args[i] != NULL && strcmp(args[i], "--") == 0) {
+        i++;
+    }
+    if (args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0') {
+        return -1;
+    }
+    return parse_file(args + i, fa);
+}
+
+static int parse_filter(char **args, filter_args_t *fa) {
+    memset(fa, 0, sizeof(*fa));
+    const char *name = args[0];
+
+    if (strcmp(name, "grep") == 0) return parse_grep(args, fa);
+    if (strcmp(name, "wc") == 0) return parse_wc(args, fa);
+    if (strcmp(name, "head") == 0) return parse_lines(args, fa, 0);
+    if (strcmp(name, "tail") == 0) return parse_lines(args, fa, 1);
+    return -1;
+}
+
+// Открытие входа фильтра. Возвращает дескриптор или -1 (сообщение
+// выведено в формате соответствующей утилиты).
+static int open_input(const char *name, const filter_args_t *fa) {
+    if (fa->file == NULL) {
+        return builtin_in();
+    }
+
+    int fd = open(fa->file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (strcmp(name, "head") == 0 || strcmp(name, "tail") == 0) {
+            fprintf(stderr, "%s: cannot open '%s' for reading: %s\n", name, fa->file, strerror(errno));
+        } else {
+            fprintf(stderr, "%s: %s: %s\n", name, fa->file, strerror(errno));
+        }
+    }
+    return fd;
+}
+
+static void close_input(int fd, const filter_args_t *fa) {
+    if (fa->file != NULL) {
+        close(fd);
+    }
+}
+
+static int reader_init(line_reader_t *r, int fd) {
+    r->fd = fd;
+    r->size = FILTER_BUF_SIZE;
+    r->len = 0;
+    r->eof = 0;
+    r->buf = malloc(r->size + 1);
+    if (r->buf == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    return 0;
+}
+
+// Дочитывание блока. Возвращает длину префикса буфера из целых строк;
+// на конце ввода последняя строка без '\n' тоже считается целой.
+// -1 - ошибка чтения.
+static ssize_t reader_fill(line_reader_t *r, const char *name) {
+    for (;;) {
+        if (r->len == r->size) {
+            // Строка длиннее буфера
+            char *bigger = realloc(r->buf, r->size * 2 + 1);
+            if (bigger == NULL) {
+                perror("realloc");
+                return -1;
+            }
+            r->buf = bigger;
+            r->size *= 2;
+        }
+
+        ssize_t n = read(r->fd, r->buf + r->len, r->size - r->len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "%s: read error: %s\n", name, strerror(errno));
+            return -1;
+        }
+        if (n == 0) {
+            r->eof = 1;
+            return r->len;
+        }
+
+        size_t old = r->len;
+        r->len += n;
+        const char *last = memrchr(r->buf + old, '\n', n);
+        if (last != NULL) {
+            return last + 1 - r->buf;
+        }
+    }
+}
+
+// Перенос незаконченной строки в начало буфера
+static void reader_consume(line_reader_t *r, size_t used) {
+    memmove(r->buf, r->buf + used, r->len - used);
+    r->len -= used;
+}
+
+static size_t count_lines(const char *p, const char *end) {
+    size_t n = 0;
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        n++;
+        p++;
+    }
+    return n;
+}
+
+// Состояние grep на время одного входа
+typedef struct {
+    const filter_args_t *fa;
+    FILE *out;
+    const char *label;      // Имя входа для сообщения о двоичном файле
+    int binary;             // Во входе встретился NUL
+    unsigned long long selected;
+    int stop;               // Двоичный файл совпал: вывод закончен
+} grep_state_t;
+
+// Выбранные строки [p, end). Каждая строка заканчивается '\n'.
+static void grep_select(grep_state_t *g, const char *p, const char *end) {
+    if (p == end) {
+        return;
+    }
+    if (g->fa->count) {
+        g->selected += count_lines(p, end);
+        return;
+    }
+    g->selected++;
+    if (g->binary) {
+        // Как GNU grep: вместо строк двоичного входа - одно сообщение
+        fflush(g->out);
+        fprintf(stderr, "grep: %s: binary file matches\n", g->label);
+        g->stop = 1;
+        return;
+    }
+    fwrite(p, 1, end - p, g->out);
+}
+
+// Поиск по блоку целых строк: memmem идёт по всему блоку, а границы
+// строки находятся только вокруг совпадения
+static void grep_block(grep_state_t *g, const char *p, const char *end) {
+    const filter_args_t *fa = g->fa;
+
+    while (p < end && !g->stop) {
+        const char *match = fa->pattern_len > 0 ? memmem(p, end - p, fa->pattern, fa->pattern_len) : p;
+        if (match == NULL) {
+            if (fa->invert) {
+                grep_select(g, p, end);
+            }
+            return;
+        }
+
+        const char *line = memrchr(p, '\n', match - p);
+        line = line != NULL ? line + 1 : p;
+        const char *line_end = memchr(match, '\n', end - match);
+        line_end = line_end != NULL ? line_end + 1 : end;
+
+        if (fa->invert) {
+            grep_select(g, p, line);
+        } else {
+            grep_select(g, line, line_end);
+        }
+        p = line_end;
+    }
+}
+
+// grep -F: 0 - есть выбранные строки, 1 - нет, 2 - ошибка
+static int grep_filter(char **args) {
+    filter_args_t fa;
+    if (parse_filter(args, &fa) < 0) {
+        return 2;
+    }
+    int fd = open_input("grep", &fa);
+    if (fd < 0) {
+        return 2;
+    }
+
+    line_reader_t r;
+    if (reader_init(&r, fd) < 0) {
+        close_input(fd, &fa);
+        return 2;
+    }
+
+    grep_state_t g = {&fa, builtin_out(), fa.file ? fa.file : "(standard input)", 0, 0, 0};
+    int status = 0;
+
+    while (!r.eof && !g.stop) {
+        size_t scanned = r.len;
+        ssize_t used = reader_fill(&r, "grep");
+        if (used < 0) {
+            status = 2;
+            break;
+        }
+        if (!g.binary && memchr(r.buf + scanned, '\0', r.len - scanned) != NULL) {
+            g.binary = 1;
+        }
+        if (r.eof && used > 0 && r.buf[used - 1] != '\n') {
+            r.buf[used++] = '\n';     // grep дописывает перевод строки
+            r.len = used;
+        }
+        grep_block(&g, r.buf, r.buf + used);
+        reader_consume(&r, used);
+        if (ferror(g.out)) {
+            status = SIGPIPE_STATUS;
+            break;
+        }
+    }
+
+    if (status == 0 && fa.count) {
+        fprintf(g.out, "%llu\n", g.selected);
+    }
+    free(r.buf);
+    close_input(fd, &fa);
+    if (status != 0) {
+        return status;
+    }
+    return g.selected > 0 ? 0 : 1;
+}
+
+// wc -l: число символов '\n'
+static int wc_filter(char **args) {
+    filter_args_t fa;
+    if (parse_filter(args, &fa) < 0) {
+        return 1;
+    }
+    int fd = open_input("wc", &fa);
+    if (fd < 0) {
+        return 1;
+    }
+
+    char *buf = malloc(FILTER_BUF_SIZE);
+    if (buf == NULL) {
+        perror("malloc");
+        close_input(fd, &fa);
+        return 1;
+    }
+
+    unsigned long long lines = 0;
+    int status = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf, FILTER_BUF_SIZE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fprintf(stderr, "wc: %s: %s\n", fa.file ? fa.file : "'standard input'", strerror(errno));
+            status = 1;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        lines += count_lines(buf, buf + n);
+    }
+
+    free(buf);
+    close_input(fd, &fa);
+    if (status == 0) {
+        if (fa.file != NULL) {
+            fprintf(builtin_out(), "%llu %s\n", lines, fa.file);
+        } else {
+            fprintf(builtin_out(), "%llu\n", lines);
+        }
+    }
+    return status;
+}
+
+// head -n N: первые N строк. Если вход - обычный файл, его позиция
+// возвращается сразу за последнюю выведенную строку, как у coreutils.
+static int head_filter(char **args) {
+    filter_args_t fa;
+    if (parse_filter(args, &fa) < 0) {
+        return 1;
+    }
+    int fd = open_input("head", &fa);
+    if (fd < 0) {
+        return 1;
+    }
+
+    char *buf = malloc(FILTER_BUF_SIZE);
+    if (buf == NULL) {
+        perror("malloc");
+        close_input(fd, &fa);
+        return 1;
+    }
+
+    FILE *out = builtin_out();
+    long long left = fa.lines;
+    int status = 0;
+
+    while (left > 0) {
+        ssize_t n = read(fd, buf, FILTER_BUF_SIZE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fprintf(stderr, "head: error reading '%s': %s\n",
+                    fa.file ? fa.file : "standard input", strerror(errno));
+            status = 1;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        const char *p = buf;
+        const char *end = buf + n;
+        while (left > 0 && (p = memchr(p, '\n', end - p)) != NULL) {
+            p++;
+            left--;
+        }
+        if (p == NULL) {
+            p = end;
+        }
+        fwrite(buf, 1, p - buf, out);
+
+        if (left == 0 && p < end) {
+            lseek(fd, -(off_t)(end - p), SEEK_CUR);   // Для каналов не сработает
+        }
+        if (ferror(out)) {
+            status = SIGPIPE_STATUS;
+            break;
+        }
+    }
+
+    free(buf);
+    close_input(fd, &fa);
+    return status;
+}
+
+// Вывод хвоста [p, end) после N-й строки (tail -n +N)
+static int tail_from_start(int fd, const filter_args_t *fa, FILE *out) {
+    char *buf = malloc(FILTER_BUF_SIZE);
+    if (buf == NULL) {
+        perror("malloc");
+        return 1;
+    }
+
+    long long skip = fa->lines > 0 ? fa->lines - 1 : 0;
+    int status = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf, FILTER_BUF_SIZE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fprintf(stderr, "tail: error reading '%s': %s\n",
+                    fa->file ? fa->file : "standard input", strerror(errno));
+            status = 1;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        const char *p = buf;
+        const char *end = buf + n;
+        while (skip > 0 && p < end) {
+            const char *nl = memchr(p, '\n', end - p);
+            if (nl == NULL) {
+                p = end;
+                break;
+            }
+            p = nl + 1;
+            skip--;
+        }
+        fwrite(p, 1, end - p, out);
+        if (ferror(out)) {
+            status = SIGPIPE_STATUS;
+            break;
+        }
+    }
+
+    free(buf);
+    return status;
+}
+
+// Начало последних n строк в [buf, buf + len) или NULL, если их меньше.
+// Последняя строка без '\n' тоже считается строкой.
+static const char *last_lines(const char *buf, size_t len, long long n) {
+    size_t limit = len > 0 && buf[len - 1] == '\n' ? len - 1 : len;
+    while (n > 0) {
+        const char *nl = memrchr(buf, '\n', limit);
+        if (nl == NULL) {
+            return NULL;
+        }
+        if (--n == 0) {
+            return nl + 1;
+        }
+        limit = nl - buf;
+    }
+    return buf + len;
+}
+
+// tail -n N: последние N строк. В буфере хранится только хвост ввода:
+// когда он разрастается, всё до последних N строк отбрасывается.
+static int tail_filter(char **args) {
+    filter_args_t fa;
+    if (parse_filter(args, &fa) < 0) {
+        return 1;
+    }
+    int fd = open_input("tail", &fa);
+    if (fd < 0) {
+        return 1;
+    }
+
+    FILE *out = builtin_out();
+    if (fa.from_start) {
+        int status = tail_from_start(fd, &fa, out);
+        close_input(fd, &fa);
+        return status;
+    }
+
+    size_t size = FILTER_BUF_SIZE;
+    size_t len = 0;
+    char *buf = malloc(size);
+    if (buf == NULL) {
+        perror("malloc");
+        close_input(fd, &fa);
+        return 1;
+    }
+
+    int status = 0;
+    for (;;) {
+        if (len == size) {
+            const char *keep = fa.lines > 0 ? last_lines(buf, len, fa.lines) : buf + len;
+            if (keep != NULL && keep > buf) {
+                len -= keep - buf;
+                memmove(buf, keep, len);
+            } else {
+                char *bigger = realloc(buf, size * 2);
+                if (bigger == NULL) {
+                    perror("realloc");
+                    status = 1;
+                    break;
+                }
+                buf = bigger;
+                size *= 2;
+            }
+        }
+
+        ssize_t n = read(fd, buf + len, size - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fprintf(stderr, "tail: error reading '%s': %s\n",
+                    fa.file ? fa.file : "standard input", strerror(errno));
+            status = 1;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        len += n;
+    }
+
+    if (status == 0 && fa.lines > 0) {
+        const char *start = last_lines(buf, len, fa.lines);
+        if (start == NULL) {
+            start = buf;
+        }
+        fwrite(start, 1, buf + len - start, out);
+    }
+
+    free(buf);
+    close_input(fd, &fa);
+    return status;
+}
+
+static const builtin_t filters[] = {
+    {.name = "grep", .func = grep_filter, .flags = BUILTIN_THREAD},
+    {.name = "wc",   .func = wc_filter,   .flags = BUILTIN_THREAD},
+    {.name = "head", .func = head_filter, .flags = BUILTIN_THREAD},
+    {.name = "tail", .func = tail_filter, .flags = BUILTIN_THREAD},
+};
+
+#define FILTER_COUNT ((int)(sizeof(filters) / sizeof(filters[0])))
+
+// Локаль, которую увидит запущенная программа, - C (или POSIX).
+// Сам shell setlocale не вызывает, поэтому решают переменные окружения
+// в порядке приоритета LC_ALL, LC_CTYPE, LANG.
+static int c_locale(void) {
+    if (MB_CUR_MAX > 1) {
+        return 0;
+    }
+    const char *names[] = {"LC_ALL", "LC_CTYPE", "LANG"};
+    for (int i = 0; i < 3; i++) {
+        const char *value = getenv(names[i]);
+        if (value != NULL && value[0] != '\0') {
+            return strcmp(value, "C") == 0 || strcmp(value, "POSIX") == 0;
+        }
+    }
+    return 1;
+}
+
+// Встроенный фильтр для стадии конвейера или NULL, если команда не
+// фильтр, аргументы не поддерживаются или фильтры выключены
+const builtin_t *find_filter(char **words) {
+    if (!opt_filters || words == NULL || words[0] == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < FILTER_COUNT; i++) {
+        if (strcmp(filters[i].name, words[0]) == 0) {
+            if (filters[i].func == grep_filter && !c_locale()) {
+                return NULL;
+            }
+            filter_args_t fa;
+            return parse_filter(words, &fa) == 0 ? &filters[i] : NULL;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,1093 @@
+#define _GNU_SOURCE
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <termios.h>
+
+// Управление заданиями. Задание - конвейер или фоновая команда: его
+// процессы составляют одну группу, а в интерактивном shell группа
+// переднего плана получает терминал через tcsetpgrp.
+//
+// Статусы собираются только синхронно и только по pid процессов из
+// таблицы заданий: waitpid(-1) забрал бы статус чужого потомка (процесса
+// parallel или встроенной команды), и его владелец не узнал бы код
+// завершения. Задание переднего плана ждёт свои процессы, а фоновые
+// задания собирает jobs_reap между строками. Пока shell ждёт ввода,
+// завершение фонового процесса приходит через его pidfd и находится по
+// pid через хэш-таблицу за O(1), а остановки - через SIGCHLD в
+// signalfd (events.c) с обходом процессов таблицы.
+//
+// Фоновые задания сверх set -o maxjobs=N (или выше порогов maxload и
+// minmem) ждут в очереди, как в make -j: задание занимает номер в
+// таблице и держит ссылку на дерево разбора, а запускается в порядке
+// номеров, когда освобождается слот.
+
+#define JOB_PID_BUCKETS 1024     // Степень двойки
+
+typedef enum {
+    PROC_RUNNING,
+    PROC_STOPPED,
+    PROC_DONE
+} proc_state_t;
+
+typedef struct job_process {
+    pid_t pid;
+    int status;                      // Статус waitpid завершившегося процесса
+    proc_state_t state;
+    struct job_process *next;        // Следующий процесс задания
+    struct job_process *hash_next;   // Цепочка в таблице pid
+    struct job *job;
+    event_source_t *watch;           // pidfd процесса задания из таблицы
+} job_process_t;
+
+typedef enum {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_STOPPED,
+    JOB_DONE
+} job_state_t;
+
+struct job {
+    int id;                          // Номер %n или 0, если не в таблице
+    pid_t pgid;                      // Группа процессов или 0
+    job_process_t *procs;
+    job_process_t *last;
+    job_state_t state;
+    int notify;                      // Сообщить об изменении перед приглашением
+    int selected;                    // Указано в аргументах jobs
+    char *text;                      // Текст команды для jobs
+    struct termios tmodes;           // Режим терминала остановленного задания
+    int have_tmodes;
+    command_list_t *tree;            // Дерево задания в очереди (ссылка)
+    and_or_t *and_or;                // Связка задания в очереди
+};
+
+int job_control = 0;                 // Интерактивный shell с группами процессов
+int in_subshell = 0;                 // Дочерний shell фоновой связки
+
+static pid_t shell_pgid;
+static struct termios shell_tmodes;
+
+static job_t **table = NULL;         // table[id - 1]
+static int table_size = 0;
+static int max_id = 0;               // Наибольший занятый номер
+static int current_id = 0;           // Задание %+
+static int previous_id = 0;          // Задание %-
+
+static job_process_t *pid_buckets[JOB_PID_BUCKETS];
+
+static unsigned pid_bucket(pid_t pid) {
+    return (unsigned)pid & (JOB_PID_BUCKETS - 1);
+}
+
+static job_process_t *find_process(pid_t pid) {
+    for (job_process_t *p = pid_buckets[pid_bucket(pid)]; p != NULL; p = p->hash_next) {
+        if (p->pid == pid) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static void unhash_process(job_process_t *proc) {
+    job_process_t **link = &pid_buckets[pid_bucket(proc->pid)];
+    for (; *link != NULL; link = &(*link)->hash_next) {
+        if (*link == proc) {
+            *link = proc->hash_next;
+            return;
+        }
+    }
+}
+
+// Интерактивный shell: своя группа процессов, терминал у неё, а
+// сигналы управления заданиями shell игнорирует (потомкам они
+// возвращаются в SIG_DFL при запуске)
+void jobs_init(void) {
+    if (!isatty(STDIN_FILENO)) {
+        return;
+    }
+
+    // Запущены в фоне: ждём, пока родительский shell отдаст терминал
+    while (tcgetpgrp(STDIN_FILENO) != (shell_pgid = getpgrp())) {
+        kill(-shell_pgid, SIGTTIN);
+    }
+
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+
+    shell_pgid = getpid();
+    if (setpgid(shell_pgid, shell_pgid) < 0 && errno != EPERM) {
+        perror("setpgid");
+        return;
+    }
+    shell_pgid = getpgrp();
+    if (tcsetpgrp(STDIN_FILENO, shell_pgid) < 0) {
+        perror("tcsetpgrp");
+        return;
+    }
+    tcgetattr(STDIN_FILENO, &shell_tmodes);
+    job_control = 1;
+}
+
+// Текст конвейера для jobs: слова стадий через |
+static char *pipeline_text(const pipeline_t *pipeline) {
+    size_t len = 1;
+    for (int i = 0; i < pipeline->stage_count; i++) {
+        const command_t *cmd = pipeline->stages[i];
+        for (int w = 0; w < cmd->word_num; w++) {
+            len += strlen(cmd->words[w]) + 1;
+        }
+        len += 2;
+    }
+
+    char *text = malloc(len);
+    if (text == NULL) {
+        return NULL;
+    }
+    char *p = text;
+    for (int i = 0; i < pipeline->stage_count; i++) {
+        const command_t *cmd = pipeline->stages[i];
+        if (i > 0) {
+            p = stpcpy(p, " | ");
+        }
+        for (int w = 0; w < cmd->word_num; w++) {
+            if (w > 0) {
+                *p++ = ' ';
+            }
+            p = stpcpy(p, cmd->words[w]);
+        }
+    }
+    *p = '\0';
+    return text;
+}
+
+// Текст связки: конвейеры через && и ||
+static char *and_or_text(const and_or_t *and_or) {
+    char *text = NULL;
+    size_t len = 0;
+
+    for (int i = 0; i < and_or->count; i++) {
+        char *part = pipeline_text(and_or->pipelines[i]);
+        char *bigger = part != NULL ? realloc(text, len + strlen(part) + 5) : NULL;
+        if (bigger == NULL) {
+            free(part);
+            free(text);
+            return NULL;
+        }
+        text = bigger;
+        char *p = text + len;
+        if (i > 0) {
+            p = stpcpy(p, and_or->connectors[i] == 1 ? " && " : " || ");
+        }
+        p = stpcpy(p, part);
+        len = p - text;
+        free(part);
+    }
+    return text;
+}
+
+static job_t *new_job(char *text) {
+    if (text == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    job_t *job = calloc(1, sizeof(job_t));
+    if (job == NULL) {
+        perror("calloc");
+        free(text);
+        return NULL;
+    }
+    job->text = text;
+    job->state = JOB_RUNNING;
+    return job;
+}
+
+job_t *job_create(const pipeline_t *pipeline) {
+    return new_job(pipeline_text(pipeline));
+}
+
+// Задание для связки, выполняемой дочерним shell (связка с &)
+job_t *job_create_list(const and_or_t *and_or) {
+    return new_job(and_or_text(and_or));
+}
+
+// Группа для очередного процесса задания: -1 - группы не меняются
+// (нет управления заданиями), 0 - процесс станет лидером новой группы
+pid_t job_launch_pgid(const job_t *job) {
+    if (!job_control || job == NULL) {
+        return -1;
+    }
+    return job->pgid;
+}
+
+int job_add_process(job_t *job, pid_t pid) {
+    job_process_t *proc = calloc(1, sizeof(job_process_t));
+    if (proc == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    proc->pid = pid;
+    proc->state = PROC_RUNNING;
+    proc->job = job;
+
+    if (job->last != NULL) {
+        job->last->next = proc;
+    } else {
+        job->procs = proc;
+    }
+    job->last = proc;
+
+    unsigned bucket = pid_bucket(pid);
+    proc->hash_next = pid_buckets[bucket];
+    pid_buckets[bucket] = proc;
+
+    if (job_control) {
+        if (job->pgid == 0) {
+            job->pgid = pid;
+        }
+        // Повтор setpgid потомка: группа готова до того, как родитель
+        // отдаст ей терминал (после exec вызов просто не нужен)
+        setpgid(pid, job->pgid);
+    }
+    return 0;
+}
+
+static void free_job(job_t *job) {
+    job_process_t *proc = job->procs;
+    while (proc != NULL) {
+        job_process_t *next = proc->next;
+        unhash_process(proc);
+        events_unwatch_pid(proc->watch);
+        free(proc);
+        proc = next;
+    }
+    release_command_list(job->tree);
+    free(job->text);
+    free(job);
+}
+
+static void process_exited(void *arg);
+
+static void watch_processes(job_t *job) {
+    for (job_process_t *p = job->procs; p != NULL; p = p->next) {
+        if (p->state != PROC_DONE && p->watch == NULL) {
+            p->watch = events_watch_pid(p->pid, process_exited, p);
+        }
+    }
+}
+
+static void insert_job(job_t *job) {
+    if (max_id == table_size) {
+        int size = table_size ? table_size * 2 : 16;
+        job_t **bigger = realloc(table, size * sizeof(job_t *));
+        if (bigger == NULL) {
+            perror("realloc");
+            return;
+        }
+        for (int i = table_size; i < size; i++) {
+            bigger[i] = NULL;
+        }
+        table = bigger;
+        table_size = size;
+    }
+
+    job->id = ++max_id;
+    table[job->id - 1] = job;
+    previous_id = current_id;
+    current_id = job->id;
+    watch_processes(job);
+}
+
+// Наибольший номер задания, кроме exclude, или 0
+static int latest_job(int exclude) {
+    for (int id = max_id; id > 0; id--) {
+        if (table[id - 1] != NULL && id != exclude) {
+            return id;
+        }
+    }
+    return 0;
+}
+
+static void remove_job(job_t *job) {
+    if (job->id > 0) {
+        table[job->id - 1] = NULL;
+        while (max_id > 0 && table[max_id - 1] == NULL) {
+            max_id--;
+        }
+        if (current_id == job->id) {
+            current_id = previous_id;
+            previous_id = 0;
+        } else if (previous_id == job->id) {
+            previous_id = 0;
+        }
+        if (current_id == 0) {
+            current_id = latest_job(0);
+        }
+        if (previous_id == 0) {
+            previous_id = latest_job(current_id);
+        }
+    }
+    free_job(job);
+}
+
+static void update_job_state(job_t *job) {
+    int running = 0, stopped = 0;
+    for (job_process_t *p = job->procs; p != NULL; p = p->next) {
+        if (p->state == PROC_RUNNING) running++;
+        else if (p->state == PROC_STOPPED) stopped++;
+    }
+
+    job_state_t state = running > 0 ? JOB_RUNNING : stopped > 0 ? JOB_STOPPED : JOB_DONE;
+    if (state != job->state) {
+        job->state = state;
+        job->notify = 1;
+    }
+}
+
+static void record_status(job_process_t *proc, int status) {
+    if (WIFSTOPPED(status)) {
+        proc->state = PROC_STOPPED;
+    } else if (WIFCONTINUED(status)) {
+        proc->state = PROC_RUNNING;
+    } else {
+        proc->state = PROC_DONE;
+        proc->status = status;
+        launch_waited(proc->pid);
+    }
+}
+
+// pidfd процесса готов: процесс завершился
+static void process_exited(void *arg) {
+    job_process_t *proc = arg;
+    int status;
+    if (proc->state != PROC_DONE && waitpid(proc->pid, &status, WNOHANG) > 0) {
+        record_status(proc, status);
+        update_job_state(proc->job);
+        jobs_start_queued();
+    }
+}
+
+// Код завершения процесса в терминах shell: 128 + сигнал для убитых
+static int exit_code(int status) {
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+static int job_exit_code(const job_t *job) {
+    return job->last != NULL ? exit_code(job->last->status) : 0;
+}
+
+// Описание состояния для jobs и уведомлений
+static void format_state(const job_t *job, char *buf, size_t size) {
+    if (job->state == JOB_QUEUED) {
+        snprintf(buf, size, "Queued");
+    } else if (job->state == JOB_RUNNING) {
+        snprintf(buf, size, "Running");
+    } else if (job->state == JOB_STOPPED) {
+        snprintf(buf, size, "Stopped");
+    } else if (job->last != NULL && WIFSIGNALED(job->last->status)) {
+        snprintf(buf, size, "%s", strsignal(WTERMSIG(job->last->status)));
+    } else if (job_exit_code(job) != 0) {
+        snprintf(buf, size, "Exit %d", job_exit_code(job));
+    } else {
+        snprintf(buf, size, "Done");
+    }
+}
+
+static void print_job(const job_t *job, int with_pids) {
+    char state[64];
+    format_state(job, state, sizeof(state));
+    char mark = job->id == current_id ? '+' : job->id == previous_id ? '-' : ' ';
+
+    printf("[%d]%c  ", job->id, mark);
+    if (with_pids) {
+        printf("%d ", job->procs != NULL ? job->procs->pid : 0);
+    }
+    printf("%-22s  %s%s\n", state, job->text,
+           job->state == JOB_RUNNING || job->state == JOB_QUEUED ? " &" : "");
+}
+
+// Терминал заданию и обратно shell
+static void give_terminal(job_t *job) {
+    if (job_control && job->pgid > 0) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+        if (job->have_tmodes) {
+            tcsetattr(STDIN_FILENO, TCSADRAIN, &job->tmodes);
+        }
+    }
+}
+
+static void take_terminal(job_t *job) {
+    if (job_control && job->pgid > 0) {
+        tcsetpgrp(STDIN_FILENO, shell_pgid);
+        job->have_tmodes = tcgetattr(STDIN_FILENO, &job->tmodes) == 0;
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &shell_tmodes);
+    }
+}
+
+static void continue_job(job_t *job) {
+    for (job_process_t *p = job->procs; p != NULL; p = p->next) {
+        if (p->state == PROC_STOPPED) {
+            p->state = PROC_RUNNING;
+        }
+    }
+    if (job->pgid > 0) {
+        kill(-job->pgid, SIGCONT);
+    } else {
+        for (job_process_t *p = job->procs; p != NULL; p = p->next) {
+            if (p->state == PROC_RUNNING) {
+                kill(p->pid, SIGCONT);
+            }
+        }
+    }
+    job->state = JOB_RUNNING;
+    job->notify = 0;
+}
+
+// Ожидание процессов задания по pid, пока каждый не завершится или не
+// остановится. Остановка от чтения терминала (SIGTTIN/SIGTTOU) у
+// задания переднего плана - это гонка с tcsetpgrp: процесс продолжается.
+// Без управления заданиями (скрипт, дочерний shell фоновой связки)
+// остановки не отслеживаются: процесс ждётся до завершения.
+static void wait_processes(job_t *job, int foreground) {
+    for (job_process_t *p = job->procs; p != NULL; p = p->next) {
+        while (p->state == PROC_RUNNING) {
+            int status;
+            pid_t pid = waitpid(p->pid, &status, job_control ? WUNTRACED : 0);
+            if (pid < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // Процесс уже собран кем-то другим
+                p->state = PROC_DONE;
+                p->status = 0;
+                break;
+            }
+            if (foreground && job_control && WIFSTOPPED(status) &&
+                (WSTOPSIG(status) == SIGTTIN || WSTOPSIG(status) == SIGTTOU)) {
+                kill(p->pid, SIGCONT);
+                continue;
+            }
+            record_status(p, status);
+        }
+    }
+    update_job_state(job);
+}
+
+// Задание переднего плана: терминал отдаётся его группе, shell ждёт
+// все процессы. Остановленное (Ctrl-Z) задание попадает в таблицу, а
+// код равен 128 + SIGTSTP. allow_stop = 0 для конвейеров с потоками
+// shell: они не могут уйти в фон, поэтому процессы продолжаются.
+int job_run_foreground(job_t *job, int allow_stop) {
+    if (job == NULL) {
+        return 1;
+    }
+
+    give_terminal(job);
+    for (;;) {
+        wait_processes(job, 1);
+        if (job->state != JOB_STOPPED || allow_stop) {
+            break;
+        }
+        continue_job(job);
+    }
+    take_terminal(job);
+
+    if (job->state == JOB_STOPPED) {
+        if (job->id == 0) {
+            insert_job(job);
+        } else {
+            previous_id = current_id != job->id ? current_id : previous_id;
+            current_id = job->id;
+        }
+        job->notify = 0;
+        printf("\n");
+        print_job(job, 0);
+        return 128 + SIGTSTP;
+    }
+
+    // Как в bash: после Ctrl-C приглашение начинается с новой строки
+    int code = job_exit_code(job);
+    if (job_control && code == 128 + SIGINT) {
+        printf("\n");
+    }
+    if (job->id > 0) {
+        remove_job(job);
+    } else {
+        free_job(job);
+    }
+    return code;
+}
+
+// Фоновое задание: в таблицу, на экран номер и pid. Задание из
+// очереди уже в таблице, его запуск не печатается.
+void job_run_background(job_t *job) {
+    if (job == NULL) {
+        return;
+    }
+    if (job->id > 0) {
+        job->state = JOB_RUNNING;
+        watch_processes(job);
+        return;
+    }
+    insert_job(job);
+    printf("[%d] %d\n", job->id, job->last != NULL ? job->last->pid : 0);
+}
+
+static int running_jobs(void) {
+    int running = 0;
+    for (int id = 1; id <= max_id; id++) {
+        if (table[id - 1] != NULL && table[id - 1]->state == JOB_RUNNING) {
+            running++;
+        }
+    }
+    return running;
+}
+
+// Доступная память в MiB по /proc/meminfo или -1
+static long available_mib(void) {
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (f == NULL) {
+        return -1;
+    }
+    char line[128];
+    long kib = -1;
+    while (kib < 0 && fgets(line, sizeof(line), f) != NULL) {
+        sscanf(line, "MemAvailable: %ld kB", &kib);
+    }
+    fclose(f);
+    return kib < 0 ? -1 : kib / 1024;
+}
+
+// Нет свободного слота для фонового задания. Пороги нагрузки и памяти
+// не держат очередь, пока не идёт ни одного задания: иначе она
+// ждала бы события, которого не будет.
+static int queue_blocked(void) {
+    int running = running_jobs();
+    if (opt_maxjobs > 0 && running >= opt_maxjobs) {
+        return 1;
+    }
+    if (running == 0) {
+        return 0;
+    }
+
+    double load;
+    if (opt_maxload > 0 && getloadavg(&load, 1) == 1 && load >= opt_maxload) {
+        return 1;
+    }
+    if (opt_minmem > 0) {
+        long available = available_mib();
+        if (available >= 0 && available < opt_minmem) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int queued_jobs(void) {
+    for (int id = 1; id <= max_id; id++) {
+        if (table[id - 1] != NULL && table[id - 1]->state == JOB_QUEUED) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Встать ли новому фоновому заданию в очередь. Сначала запускаются
+// уже ждущие: новое задание не обгоняет их.
+int job_should_queue(void) {
+    if (max_id == 0) {
+        return 0;
+    }
+    jobs_start_queued();
+    return queued_jobs() || queue_blocked();
+}
+
+// Задание в очередь: дерево разбора живёт, пока задание не запущено
+void job_enqueue(job_t *job, command_list_t *tree, and_or_t *and_or) {
+    tree->refcount++;
+    job->tree = tree;
+    job->and_or = and_or;
+    job->state = JOB_QUEUED;
+    insert_job(job);
+    printf("[%d] queued\n", job->id);
+}
+
+// Запуск задания из очереди; при ошибке задание удаляется из таблицы
+static int start_queued_job(job_t *job) {
+    // Ссылка на дерево больше не нужна: дочерний shell получил копию,
+    // а одиночная команда уже запущена
+    command_list_t *tree = job->tree;
+    job->tree = NULL;
+    int status = launch_background(job, job->and_or);
+    release_command_list(tree);
+    return status;
+}
+
+// Запуск заданий из очереди по порядку, пока есть свободные слоты
+void jobs_start_queued(void) {
+    for (int id = 1; id <= max_id; id++) {
+        job_t *job = table[id - 1];
+        if (job == NULL || job->state != JOB_QUEUED) {
+            continue;
+        }
+        if (queue_blocked()) {
+            return;
+        }
+        start_queued_job(job);
+    }
+}
+
+// Дочерний shell фоновой связки. Терминал остаётся у родителя, а
+// таблица заданий начинается пустой. Таблица родителя не
+// освобождается: её pidfd зарегистрированы в общем с родителем epoll,
+// и снятие их с наблюдения затронуло бы родителя. Без управления
+// заданиями фоновая связка, как в POSIX, не реагирует на Ctrl-C.
+void jobs_enter_subshell(void) {
+    int sig_default = job_control;
+    job_control = 0;
+    in_subshell = 1;
+
+    table = NULL;
+    table_size = 0;
+    max_id = 0;
+    current_id = 0;
+    previous_id = 0;
+    memset(pid_buckets, 0, sizeof(pid_buckets));
+
+    signal(SIGINT, sig_default ? SIG_DFL : SIG_IGN);
+    signal(SIGQUIT, sig_default ? SIG_DFL : SIG_IGN);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTIN, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+
+    // Сигналы, заблокированные циклом событий родителя
+    sigset_t empty;
+    sigemptyset(&empty);
+    sigprocmask(SIG_SETMASK, &empty, NULL);
+}
+
+// Задание, процессы которого уже собраны вызывающим (неудачный запуск)
+void job_discard(job_t *job) {
+    if (job == NULL) {
+        return;
+    }
+    if (job->id > 0) {
+        remove_job(job);
+    } else {
+        free_job(job);
+    }
+}
+
+// Сбор статусов процессов фоновых заданий без ожидания, каждого по
+// своему pid. Возвращает число полученных статусов.
+static int reap_tracked(int options) {
+    int changed = 0;
+    for (int id = 1; id <= max_id; id++) {
+        job_t *job = table[id - 1];
+        if (job == NULL) {
+            continue;
+        }
+        int before = changed;
+        for (job_process_t *p = job->procs; p != NULL; p = p->next) {
+            int status;
+            while (p->state != PROC_DONE && waitpid(p->pid, &status, options | WNOHANG) > 0) {
+                record_status(p, status);
+                changed++;
+            }
+        }
+        if (changed > before) {
+            update_job_state(job);
+        }
+    }
+    return changed;
+}
+
+// Сбор статусов фоновых заданий без ожидания. Вызывается между
+// строками: потомков переднего плана в этот момент нет.
+void jobs_reap(void) {
+    if (max_id == 0) {
+        return;
+    }
+    reap_tracked(WUNTRACED | WCONTINUED);
+    jobs_start_queued();
+}
+
+// Есть ли задания с неотправленным уведомлением
+int jobs_pending(void) {
+    for (int i = 1; i <= max_id; i++) {
+        if (table[i - 1] != NULL && table[i - 1]->notify) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Уведомления о завершённых и остановленных фоновых заданиях
+void jobs_notify(void) {
+    for (int i = 1; i <= max_id; i++) {
+        job_t *job = table[i - 1];
+        if (job == NULL || !job->notify) {
+            continue;
+        }
+        job->notify = 0;
+        print_job(job, 0);
+        if (job->state == JOB_DONE) {
+            remove_job(job);
+        }
+    }
+    fflush(stdout);
+}
+
+// Задание по обозначению %n, %%, %+, %-, %строка или pid
+static job_t *parse_job_spec(const char *spec, const char *builtin) {
+    job_t *job = NULL;
+
+    if (spec == NULL || strcmp(spec, "%%") == 0 || strcmp(spec, "%+") == 0) {
+        job = current_id > 0 ? table[current_id - 1] : NULL;
+    } else if (strcmp(spec, "%-") == 0) {
+        job = previous_id > 0 ? table[previous_id - 1] : NULL;
+    } else if (spec[0] == '%' && isdigit((unsigned char)spec[1])) {
+        int id = atoi(spec + 1);
+        job = id > 0 && id <= max_id ? table[id - 1] : NULL;
+    } else if (spec[0] == '%') {
+        // Задание, команда которого начинается со строки
+        for (int i = max_id; i > 0 && job == NULL; i--) {
+            if (table[i - 1] != NULL && strncmp(table[i - 1]->text, spec + 1, strlen(spec + 1)) == 0) {
+                job = table[i - 1];
+            }
+        }
+    } else if (isdigit((unsigned char)spec[0])) {
+        job_process_t *proc = find_process((pid_t)atoi(spec));
+        job = proc != NULL && proc->job->id > 0 ? proc->job : NULL;
+    }
+
+    if (job == NULL) {
+        fprintf(stderr, "%s: %s: no such job\n", builtin, spec != NULL ? spec : "current");
+    }
+    return job;
+}
+
+// jobs [-l] [-p] [задание...]
+int jobs_builtin(char **args) {
+    int with_pids = 0, only_pids = 0;
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-l") == 0) {
+            with_pids = 1;
+        } else if (strcmp(args[i], "-p") == 0) {
+            only_pids = 1;
+        } else {
+            fprintf(stderr, "jobs: invalid option '%s'\n", args[i]);
+            fprintf(stderr, "Usage: jobs [-l] [-p] [job...]\n");
+            return 2;
+        }
+    }
+
+    jobs_reap();
+
+    // Каждое обозначение разбирается один раз: ошибка выводится один
+    // раз, а задания отмечаются для вывода в порядке номеров
+    int status = 0;
+    for (int id = 1; id <= max_id; id++) {
+        if (table[id - 1] != NULL) {
+            table[id - 1]->selected = args[i] == NULL;
+        }
+    }
+    for (int j = i; args[j] != NULL; j++) {
+        job_t *job = parse_job_spec(args[j], "jobs");
+        if (job == NULL) {
+            status = 1;
+        } else {
+            job->selected = 1;
+        }
+    }
+
+    for (int id = 1; id <= max_id; id++) {
+        job_t *job = table[id - 1];
+        if (job == NULL || !job->selected) {
+            continue;
+        }
+
+        if (only_pids) {
+            if (job->procs != NULL) {
+                printf("%d\n", job->pgid > 0 ? job->pgid : job->procs->pid);
+            }
+        } else {
+            print_job(job, with_pids);
+        }
+        job->notify = 0;
+        if (job->state == JOB_DONE) {
+            remove_job(job);
+        }
+    }
+    return status;
+}
+
+// fg [задание]: продолжить задание на переднем плане
+int fg_builtin(char **args) {
+    jobs_reap();
+    job_t *job = parse_job_spec(args[1], "fg");
+    if (job == NULL) {
+        return 1;
+    }
+
+    printf("%s\n", job->text);
+    fflush(stdout);
+    if (job->state == JOB_QUEUED) {
+        // Задание из очереди запускается сразу, без ожидания слота
+        int status = start_queued_job(job);
+        if (status != 0) {
+            return status;
+        }
+    } else if (job->state == JOB_STOPPED) {
+        give_terminal(job);
+        continue_job(job);
+    }
+    return job_run_foreground(job, 1);
+}
+
+// bg [задание...]: продолжить остановленные задания в фоне
+int bg_builtin(char **args) {
+    jobs_reap();
+    char *current[] = {NULL, NULL};
+    char **specs = args[1] != NULL ? args + 1 : current;
+    int status = 0;
+
+    for (int i = 0; i == 0 || specs[i] != NULL; i++) {
+        job_t *job = parse_job_spec(specs[i], "bg");
+        if (job == NULL) {
+            status = 1;
+        } else if (job->state == JOB_RUNNING) {
+            fprintf(stderr, "bg: job %d already in background\n", job->id);
+        } else if (job->state == JOB_QUEUED) {
+            // bg запускает задание из очереди, не дожидаясь слота
+            if (start_queued_job(job) != 0) {
+                status = 1;
+            } else {
+                printf("[%d]%c %s &\n", job->id, job->id == current_id ? '+' : ' ', job->text);
+            }
+        } else {
+            continue_job(job);
+            printf("[%d]%c %s &\n", job->id, job->id == current_id ? '+' : ' ', job->text);
+        }
+    }
+    return status;
+}
+
+// Ожидание любого процесса фоновых заданий. Освободившиеся слоты сразу
+// получают задания из очереди. 0 - больше ждать нечего, -1 - ожидание
+// прервал Ctrl-C.
+//
+// Ждать «любого» через waitpid(-1) нельзя (см. начало файла), поэтому
+// shell спит в sigwaitinfo на заблокированном SIGCHLD и после каждого
+// сигнала обходит свои процессы. Сигнал, пришедший между обходом и
+// ожиданием, остаётся в очереди и не теряется. В цикле событий SIGINT
+// заблокирован навсегда (events.c), поэтому он ждётся вместе с SIGCHLD.
+static int wait_any(void) {
+    jobs_start_queued();
+    if (running_jobs() == 0) {
+        return 0;
+    }
+
+    sigset_t set, old;
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    if (events_active()) {
+        sigaddset(&set, SIGINT);
+    }
+    sigprocmask(SIG_BLOCK, &set, &old);
+
+    int options = job_control ? WUNTRACED : 0;
+    int result = 1;
+    while (reap_tracked(options) == 0) {
+        int sig = sigwaitinfo(&set, NULL);
+        if (sig == SIGINT) {
+            result = -1;
+            break;
+        }
+        if (sig < 0 && errno != EINTR) {
+            perror("sigwaitinfo");
+            break;
+        }
+    }
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return result;
+}
+
+// Ожидание фонового задания до завершения (остановки не в счёт).
+// Задание из очереди сначала дожидается слота. -1 - прервано Ctrl-C.
+static int wait_job(job_t *job) {
+    int id = job->id;
+    while (job->state == JOB_QUEUED || job->state == JOB_RUNNING) {
+        int more = wait_any();
+        if (more < 0) {
+            return -1;
+        }
+        if (id > max_id || table[id - 1] != job) {
+            return 127;         // Запуск не удался, задание удалено
+        }
+        if (!more) {
+            break;
+        }
+    }
+    int code = job->state == JOB_STOPPED ? 128 + SIGTSTP : job_exit_code(job);
+    job->notify = 0;
+    if (job->state == JOB_DONE) {
+        remove_job(job);
+    }
+    return code;
+}
+
+// Ctrl-C прерывает wait с кодом 130, как в bash; приглашение
+// выводится с новой строки после ^C
+static int wait_interrupted(void) {
+    putchar('\n');
+    fflush(stdout);
+    return 130;
+}
+
+// wait [задание|pid ...]: без аргументов - все фоновые задания
+int wait_builtin(char **args) {
+    jobs_reap();
+    int status = 0;
+
+    // Все задания, включая очередь: первый завершившийся процесс
+    // освобождает слот, а не задание с меньшим номером
+    if (args[1] == NULL) {
+        int more;
+        while ((more = wait_any()) > 0) {
+            continue;
+        }
+        for (int id = 1; id <= max_id; id++) {
+            if (table[id - 1] != NULL && table[id - 1]->state == JOB_DONE) {
+                remove_job(table[id - 1]);
+            }
+        }
+        return more < 0 ? wait_interrupted() : 0;
+    }
+
+    for (int i = 1; args[i] != NULL; i++) {
+        job_t *job = parse_job_spec(args[i], "wait");
+        status = job != NULL ? wait_job(job) : 127;
+        if (status < 0) {
+            return wait_interrupted();
+        }
+    }
+    return status;
+}
+
+static const struct {
+    const char *name;
+    int number;
+} signal_names[] = {
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"ILL", SIGILL},
+    {"TRAP", SIGTRAP}, {"ABRT", SIGABRT}, {"BUS", SIGBUS}, {"FPE", SIGFPE},
+    {"KILL", SIGKILL}, {"USR1", SIGUSR1}, {"SEGV", SIGSEGV}, {"USR2", SIGUSR2},
+    {"PIPE", SIGPIPE}, {"ALRM", SIGALRM}, {"TERM", SIGTERM}, {"CHLD", SIGCHLD},
+    {"CONT", SIGCONT}, {"STOP", SIGSTOP}, {"TSTP", SIGTSTP}, {"TTIN", SIGTTIN},
+    {"TTOU", SIGTTOU}, {"URG", SIGURG}, {"XCPU", SIGXCPU}, {"XFSZ", SIGXFSZ},
+    {"VTALRM", SIGVTALRM}, {"PROF", SIGPROF}, {"WINCH", SIGWINCH}, {"SYS", SIGSYS},
+};
+
+#define SIGNAL_NAME_COUNT ((int)(sizeof(signal_names) / sizeof(signal_names[0])))
+
+static int parse_signal(const char *s) {
+    if (isdigit((unsigned char)s[0])) {
+        int n = atoi(s);
+        return n >= 0 && n < NSIG ? n : -1;
+    }
+    if (strncmp(s, "SIG", 3) == 0) {
+        s += 3;
+    }
+    for (int i = 0; i < SIGNAL_NAME_COUNT; i++) {
+        if (strcasecmp(signal_names[i].name, s) == 0) {
+            return signal_names[i].number;
+        }
+    }
+    return -1;
+}
+
+// kill [-s сигнал | -сигнал] задание|pid ...   kill -l
+int kill_builtin(char **args) {
+    int sig = SIGTERM;
+    int i = 1;
+
+    if (args[1] != NULL && strcmp(args[1], "-l") == 0) {
+        for (int j = 0; j < SIGNAL_NAME_COUNT; j++) {
+            printf("%2d) SIG%s\n", signal_names[j].number, signal_names[j].name);
+        }
+        return 0;
+    }
+    if (args[i] != NULL && strcmp(args[i], "-s") == 0 && args[i + 1] != NULL) {
+        sig = parse_signal(args[i + 1]);
+        i += 2;
+    } else if (args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0') {
+        sig = parse_signal(args[i] + 1);
+        i++;
+    }
+    if (sig < 0) {
+        fprintf(stderr, "kill: %s: invalid signal specification\n", args[i - 1]);
+        return 1;
+    }
+    if (args[i] == NULL) {
+        fprintf(stderr, "Usage: kill [-s sigspec | -sigspec] pid | %%job ... or kill -l\n");
+        return 2;
+    }
+
+    jobs_reap();
+    int status = 0;
+    for (; args[i] != NULL; i++) {
+        if (args[i][0] == '%') {
+            job_t *job = parse_job_spec(args[i], "kill");
+            if (job == NULL) {
+                status = 1;
+                continue;
+            }
+            // Задание из очереди ещё не запущено: оно просто удаляется
+            if (job->state == JOB_QUEUED) {
+                if (sig != 0) {
+                    remove_job(job);
+                }
+                continue;
+            }
+            int failed = 0;
+            if (job->pgid > 0) {
+                failed = kill(-job->pgid, sig) < 0;
+            } else {
+                for (job_process_t *p = job->procs; p != NULL; p = p->next) {
+                    if (p->state != PROC_DONE && kill(p->pid, sig) < 0) failed = 1;
+                }
+            }
+            if (failed) {
+                fprintf(stderr, "kill: %s: %s\n", args[i], strerror(errno));
+                status = 1;
+            }
+            if (sig == SIGCONT && !failed) {
+                continue_job(job);
+            }
+            continue;
+        }
+
+        char *end;
+        long pid = strtol(args[i], &end, 10);
+        if (end == args[i] || *end != '\0') {
+            fprintf(stderr, "kill: %s: arguments must be process or job IDs\n", args[i]);
+            status = 1;
+        } else if (kill((pid_t)pid, sig) < 0) {
+            fprintf(stderr, "kill: (%ld) - %s\n", pid, strerror(errno));
+            status = 1;
+        }
+    }
+    return status;
+}
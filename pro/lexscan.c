@@ -0,0 +1,153 @@
+#include "shell.h"
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LEXSCAN_X86 1
+#endif
+
+// Классы символов лексера: одна таблица вместо strchr по спискам
+const unsigned char char_class[256] = {
+    [' ']  = CH_DELIM, ['\t'] = CH_DELIM, ['\n'] = CH_DELIM, ['\r'] = CH_DELIM,
+    ['"']  = CH_QUOTE, ['\''] = CH_QUOTE,
+    ['\\'] = CH_ESCAPE,
+    ['>']  = CH_OPERATOR, ['<'] = CH_OPERATOR, ['|'] = CH_OPERATOR,
+    [';']  = CH_OPERATOR | CH_SPECIAL, ['&'] = CH_OPERATOR | CH_SPECIAL,
+    ['@']  = CH_SPECIAL, ['#'] = CH_SPECIAL, ['%'] = CH_SPECIAL, ['!'] = CH_SPECIAL,
+    ['$']  = CH_SPECIAL, ['^'] = CH_SPECIAL, [':'] = CH_SPECIAL, [','] = CH_SPECIAL,
+    ['(']  = CH_SPECIAL, [')'] = CH_SPECIAL, ['{'] = CH_SPECIAL, ['}'] = CH_SPECIAL,
+    ['[']  = CH_SPECIAL, [']'] = CH_SPECIAL,
+};
+
+#define CH_STOP (CH_DELIM | CH_QUOTE | CH_ESCAPE | CH_OPERATOR)
+
+static size_t scan_word_run_scalar(const char *p, const char *end) {
+    const char *start = p;
+    while (p < end && !(char_class[(unsigned char)*p] & CH_STOP)) {
+        p++;
+    }
+    return p - start;
+}
+
+#ifdef LEXSCAN_X86
+
+// Векторные версии находят кандидатов на остановку: все байты <= 0x20
+// (пробелы и управляющие символы) и " ' \ > < | ; &. Управляющие
+// символы, которые на самом деле обычные, перепроверяются по таблице.
+
+__attribute__((target("sse2")))
+static size_t scan_word_run_sse2(const char *p, const char *end) {
+    const char *start = p;
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i squote = _mm_set1_epi8('\'');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i bar = _mm_set1_epi8('|');
+    const __m128i semi = _mm_set1_epi8(';');
+    const __m128i amp = _mm_set1_epi8('&');
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(v, space), v);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, dquote));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, squote));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, backslash));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, gt));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, lt));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, bar));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, semi));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, amp));
+
+        unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        while (mask != 0) {
+            int bit = __builtin_ctz(mask);
+            if (char_class[(unsigned char)p[bit]] & CH_STOP) {
+                return (p + bit) - start;
+            }
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+
+    return (p - start) + scan_word_run_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_word_run_avx2(const char *p, const char *end) {
+    const char *start = p;
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i squote = _mm256_set1_epi8('\'');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i bar = _mm256_set1_epi8('|');
+    const __m256i semi = _mm256_set1_epi8(';');
+    const __m256i amp = _mm256_set1_epi8('&');
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(v, space), v);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, dquote));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, squote));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, backslash));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, gt));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, lt));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, bar));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, semi));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, amp));
+
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        while (mask != 0) {
+            int bit = __builtin_ctz(mask);
+            if (char_class[(unsigned char)p[bit]] & CH_STOP) {
+                return (p + bit) - start;
+            }
+            mask &= mask - 1;
+        }
+        p += 32;
+    }
+
+    return (p - start) + scan_word_run_sse2(p, end);
+}
+
+#endif
+
+static size_t scan_word_run_resolve(const char *p, const char *end);
+
+static size_t (*scan_word_run_impl)(const char *, const char *) = scan_word_run_resolve;
+static const char *scan_impl_name = "scalar";
+
+// Выбор реализации по возможностям процессора при первом вызове
+static size_t scan_word_run_resolve(const char *p, const char *end) {
+    scan_word_run_impl = scan_word_run_scalar;
+    scan_impl_name = "scalar";
+
+#ifdef LEXSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_word_run_impl = scan_word_run_avx2;
+        scan_impl_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        scan_word_run_impl = scan_word_run_sse2;
+        scan_impl_name = "sse2";
+    }
+#endif
+
+    return scan_word_run_impl(p, end);
+}
+
+// Длина серии обычных символов слова начиная с p (не дальше end):
+// останавливается на пробелах, кавычках, обратном слеше и операторах
+size_t scan_word_run(const char *p, const char *end) {
+    return scan_word_run_impl(p, end);
+}
+
+const char *scan_word_run_name(void) {
+    if (scan_word_run_impl == scan_word_run_resolve) {
+        scan_word_run_resolve("", "");
+    }
+    return scan_impl_name;
+}
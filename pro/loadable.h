@@ -0,0 +1,40 @@
+#ifndef LOADABLE_H
+#define LOADABLE_H
+
+// ABI загружаемых встроенных команд (enable -f библиотека.so имя).
+//
+// Библиотека экспортирует для каждой команды структуру
+//     shell_loadable_t <имя>_builtin
+// Shell проверяет abi_version, вызывает load (если есть) и добавляет
+// команду в реестр. Команда выполняется в процессе shell без fork:
+//   - argv[0] - имя команды, argv[argc] == NULL;
+//   - вывод - в io->out_fd/io->err_fd (write) или в stdout/stderr:
+//     shell сбрасывает буферы stdio до и после вызова;
+//   - окружение - io->envp, а также обычные getenv/setenv;
+//   - возвращаемое значение - код завершения команды.
+// Команда не должна вызывать exit и оставлять открытыми дескрипторы.
+// При enable -d вызывается unload, затем библиотека выгружается.
+
+#define SHELL_LOADABLE_ABI_VERSION 1
+
+// Флаги команды
+#define SHELL_LOADABLE_STATE 0x01    // Меняет состояние shell (окружение, каталог)
+
+typedef struct {
+    int in_fd;              // Стандартный ввод команды
+    int out_fd;             // Стандартный вывод
+    int err_fd;             // Стандартный вывод ошибок
+    char **envp;            // Окружение shell
+} shell_builtin_io_t;
+
+typedef struct {
+    int abi_version;        // SHELL_LOADABLE_ABI_VERSION
+    const char *name;       // Имя команды
+    int (*run)(int argc, char **argv, const shell_builtin_io_t *io);
+    int flags;              // SHELL_LOADABLE_*
+    const char *usage;      // Краткая справка (может быть NULL)
+    int (*load)(void);      // Вызывается после загрузки, 0 - успех (может быть NULL)
+    void (*unload)(void);   // Вызывается перед выгрузкой (может быть NULL)
+} shell_loadable_t;
+
+#endif
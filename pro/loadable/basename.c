@@ -0,0 +1,70 @@
+#include "../loadable.h"
+#include <string.h>
+#include <unistd.h>
+
+// Пример загружаемой встроенной команды: basename строка [суффикс]
+//
+//   make loadables
+//   enable -f ./loadable/basename.so basename
+//   basename /usr/lib/libc.so .so
+
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int basename_run(int argc, char **argv, const shell_builtin_io_t *io) {
+    if (argc < 2 || argc > 3) {
+        const char *usage = "Usage: basename string [suffix]\n";
+        write_all(io->err_fd, usage, strlen(usage));
+        return 1;
+    }
+
+    const char *path = argv[1];
+    size_t len = strlen(path);
+
+    // Завершающие слеши не считаются
+    while (len > 1 && path[len - 1] == '/') {
+        len--;
+    }
+
+    size_t start = len;
+    while (start > 0 && path[start - 1] != '/') {
+        start--;
+    }
+    if (len == 1 && path[0] == '/') {
+        start = 0;
+    }
+
+    // Суффикс снимается, если он не совпадает со всем именем
+    if (argc == 3) {
+        size_t suffix_len = strlen(argv[2]);
+        if (suffix_len < len - start &&
+            memcmp(path + len - suffix_len, argv[2], suffix_len) == 0) {
+            len -= suffix_len;
+        }
+    }
+
+    if (write_all(io->out_fd, path + start, len - start) < 0 ||
+        write_all(io->out_fd, "\n", 1) < 0) {
+        return 1;
+    }
+    return 0;
+}
+
+shell_loadable_t basename_builtin = {
+    SHELL_LOADABLE_ABI_VERSION,
+    "basename",
+    basename_run,
+    0,
+    "basename string [suffix]",
+    NULL,
+    NULL,
+};
@@ -10,15 +10,6 @@
 
 history_t *global_history = NULL;
 
-void check_child(int sig) {
-    int status;
-    pid_t pid;
-    
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        printf("[%d] Finished with status %d\n", pid, WEXITSTATUS(status));
-    }
-}
-
 char* print_dir() {
     long size = pathconf(".", _PC_PATH_MAX);
     if (size == -1) {
@@ -41,14 +32,20 @@ char* print_dir() {
     return cwd;
 }
 
+// Приглашение; возвращает его длину в символах
+static int print_prompt(void) {
+    char *dir = print_dir();
+    int len = printf("%s> ", dir);
+    free(dir);
+    fflush(stdout);
+    return len;
+}
+
 char *read_line(void) {
     char *line = NULL;
     size_t linesize = 0;
-    char* dir = print_dir();
 
-    printf("%s> ", dir);
-    fflush(stdout);
-    free(dir);
+    print_prompt();
     
     ssize_t num_chars_read = getline(&line, &linesize, stdin);
     
@@ -64,6 +61,16 @@ char *read_line(void) {
     return line;
 }
 
+// Очередная клавиша: из цикла событий или, если он не запущен,
+// напрямую из stdin
+static int read_key(int allow_notify) {
+    if (events_active()) {
+        return events_read_key(allow_notify);
+    }
+    int c = getchar();
+    return c == EOF ? KEY_EOF : c;
+}
+
 // Новая функция чтения строки с поддержкой истории
 char *read_line_with_history(history_t *hist) {
     static int terminal_initialized = 0;
@@ -79,6 +86,11 @@ char *read_line_with_history(history_t *hist) {
             return line;
         }
         terminal_initialized = 1;
+        // Ожидание ввода, сигналов и завершения фоновых заданий в
+        // epoll; без него - обычное чтение stdin
+        events_init();
+    } else if (enter_raw_mode() == -1) {
+        return read_line();
     }
     
     char *line = malloc(MAX_INPUT_LENGTH);
@@ -91,20 +103,41 @@ char *read_line_with_history(history_t *hist) {
     int hist_index = -1;  // -1 = новая команда
     line[0] = '\0';
     
-    char *dir = print_dir();
-    printf("%s> ", dir);
-    free(dir);
-    fflush(stdout);
+    events_discard_signals();
+    int prompt_len = print_prompt();
     
     while (1) {
-        char c = getchar();
+        int c = read_key(1);
         
         if (c == '\n') {  // Enter
             break;
+        } else if (c == KEY_EOF) {  // Терминал закрыт
+            restore_terminal();
+            free(line);
+            return NULL;
+        } else if (c == KEY_INTERRUPT) {  // Ctrl-C: строка сбрасывается
+            printf("^C\n");
+            pos = 0;
+            line[0] = '\0';
+            hist_index = -1;
+            prompt_len = print_prompt();
+        } else if (c == KEY_NOTIFY) {
+            // Уведомления о заданиях выводятся на месте строки ввода,
+            // затем приглашение и набранный текст повторяются
+            int width = prompt_len + pos;
+            int rows = width > 0 ? (width - 1) / events_columns() : 0;
+            if (rows > 0) {
+                printf("\033[%dA", rows);
+            }
+            printf("\r\033[J");
+            jobs_notify();
+            prompt_len = print_prompt();
+            printf("%s", line);
+            fflush(stdout);
         } else if (c == '\x1b') {  // Escape sequence (стрелки)
-            char c2 = getchar();
+            int c2 = read_key(0);
             if (c2 == '[') {
-                char c3 = getchar();
+                int c3 = read_key(0);
                 
                 if (c3 == 'A' && hist) {  // Стрелка вверх
                     if (hist_index < hist->count - 1) {
@@ -166,6 +199,8 @@ char *read_line_with_history(history_t *hist) {
         // Игнорируем другие управляющие символы
     }
     
+    // Команды получают терминал в обычном режиме
+    restore_terminal();
     printf("\n");
     return line;
 }
@@ -183,12 +218,27 @@ int main(void) {
         printf("Command history loaded (%d commands)\n", history->count);
     }
     
-    signal(SIGCHLD, check_child);
+    // Группа процессов shell и терминал; фоновые задания собираются
+    // перед каждым приглашением (jobs_reap), а не в обработчике SIGCHLD
+    jobs_init();
+
+    line_arena = arena_create();
+    if (line_arena == NULL) {
+        fprintf(stderr, "Error: failed to create line arena\n");
+        return 1;
+    }
+
+    // Общий индекс команд PATH: отображается или строится один раз
+    exe_index_open();
+    arena_reset(line_arena);
     
     printf("Shell R v7.2 with Command History\n");
     printf("Type 'exit' to quit. Use Up/Down arrows for history.\n");
     
     while (1) {
+        jobs_reap();
+        jobs_notify();
+
         if (history) {
             input = read_line_with_history(history);
         } else {
@@ -209,13 +259,21 @@ int main(void) {
             add_to_history(history, input);
         }
         
-        command_t *cmd = parse_input(input);
-        if (cmd != NULL) {
-            execute_command(cmd);
-            free_command(cmd);
+        // Строка разбирается в дерево один раз и исполняется напрямую;
+        // повторные строки берутся из кэша разбора
+        command_list_t *list = parse_line_cached(input);
+        if (list != NULL) {
+            execute_command_list(list);
+            release_command_list(list);
         }
         
         free(input);
+
+        // Вся временная память строки освобождается одной операцией,
+        // а накопившиеся свободные блоки отдаются ОС, пока shell ждёт ввода
+        stat_cache_invalidate();
+        arena_reset(line_arena);
+        arena_trim();
     }
     
     // Сохраняем историю при выходе
@@ -0,0 +1,66 @@
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Генератор совершенной хэш-функции для реестра встроенных команд.
+// Перебирает затравку builtin_hash, пока все имена из builtins.def не
+// попадут в разные ячейки таблицы, и печатает заголовок с затравкой,
+// размером и таблицей ячеек (номер в реестре или -1).
+//
+// Использование: ./mkbuiltins > builtins_hash.h
+
+static const char *names[] = {
+#define BUILTIN(name, func, flags) name,
+#include "builtins.def"
+#undef BUILTIN
+};
+
+#define NAME_COUNT ((int)(sizeof(names) / sizeof(names[0])))
+#define MAX_SEED 1000000
+
+int main(void) {
+    for (unsigned size = 16; size <= 4096; size *= 2) {
+        if (size < 2 * (unsigned)NAME_COUNT) {
+            continue;
+        }
+
+        int *slots = malloc(size * sizeof(int));
+        if (slots == NULL) {
+            perror("malloc");
+            return 1;
+        }
+
+        for (unsigned seed = 1; seed < MAX_SEED; seed++) {
+            int ok = 1;
+            for (unsigned i = 0; i < size; i++) {
+                slots[i] = -1;
+            }
+            for (int i = 0; i < NAME_COUNT && ok; i++) {
+                unsigned slot = builtin_hash(names[i], seed) & (size - 1);
+                if (slots[slot] != -1) {
+                    ok = 0;
+                }
+                slots[slot] = i;
+            }
+            if (!ok) {
+                continue;
+            }
+
+            printf("// Сгенерировано mkbuiltins по builtins.def, не редактировать\n");
+            printf("#define BUILTIN_HASH_SEED %uu\n", seed);
+            printf("#define BUILTIN_HASH_SIZE %u\n\n", size);
+            printf("static const short builtin_slots[BUILTIN_HASH_SIZE] = {");
+            for (unsigned i = 0; i < size; i++) {
+                printf("%s%d,", i % 16 == 0 ? "\n    " : " ", slots[i]);
+            }
+            printf("\n};\n");
+            free(slots);
+            return 0;
+        }
+        free(slots);
+    }
+
+    fprintf(stderr, "mkbuiltins: no perfect hash found for %d builtins\n", NAME_COUNT);
+    return 1;
+}
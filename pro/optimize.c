@@ -0,0 +1,179 @@
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// Оптимизатор конвейеров (set -o optimize). Перед запуском конвейер
+// переписывается в равносильный с меньшим числом стадий:
+//
+//   cat файл | cmd ...   ->  cmd ... < файл
+//   cmd ... | cat        ->  cmd ...          (stdout shell - не терминал)
+//
+// Каждая стадия - это fork, exec и лишнее копирование данных через pipe.
+// Дерево разбора общее с кэшем разбора, поэтому оно не меняется: новый
+// конвейер собирается во временной арене строки. С set -o explain
+// каждая перезапись выводится в stderr.
+//
+// Конвейер, в котором остаётся встроенная команда (в том числе
+// загруженная через enable -f), не переписывается: в конвейере каждая
+// стадия работает в потомке или потоке, а одиночная встроенная команда
+// выполнилась бы в самом shell (cd / | cat сменил бы его каталог).
+
+// cat - внешняя программа, а не подменённая встроенной командой
+static int stage_is_cat(const command_t *cmd) {
+    return cmd->word_num > 0 && strcmp(cmd->words[0], "cat") == 0 && cmd->redirect_count == 0 &&
+           find_builtin("cat") == NULL;
+}
+
+// Есть ли встроенные команды среди стадий first..last
+static int has_builtin_stage(const pipeline_t *pipeline, int first, int last) {
+    for (int i = first; i <= last; i++) {
+        const command_t *cmd = pipeline->stages[i];
+        if (cmd->word_num > 0 && find_builtin(cmd->words[0]) != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Трогают ли перенаправления команды stdin
+static int touches_stdin(const command_t *cmd) {
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        const redirect_t *r = &cmd->redirects[i];
+        if (r->fd == STDIN_FILENO || (r->op == REDIR_DUP && r->src_fd == STDIN_FILENO)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// cat файл | cmd: файл должен быть обычным и читаемым уже сейчас,
+// иначе сообщение об ошибке и статус конвейера были бы другими
+static int leading_cat_file(const command_t *cat, const command_t *next) {
+    if (!stage_is_cat(cat) || cat->word_num != 2 || touches_stdin(next)) {
+        return 0;
+    }
+    const char *file = cat->words[1];
+    if (file[0] == '-') {
+        return 0;               // Опция или stdin
+    }
+
+    struct stat st;
+    return stat(file, &st) == 0 && S_ISREG(st.st_mode) && access(file, R_OK) == 0;
+}
+
+// Копия команды с перенаправлением stdin из файла перед её
+// собственными перенаправлениями - там же, где был бы pipe
+static command_t *redirect_from_file(const command_t *cmd, const char *file) {
+    command_t *copy = arena_alloc(line_arena, sizeof(command_t));
+    redirect_t *redirects = arena_alloc(line_arena, (cmd->redirect_count + 1) * sizeof(redirect_t));
+    if (copy == NULL || redirects == NULL) {
+        return NULL;
+    }
+
+    redirects[0].op = REDIR_OPEN;
+    redirects[0].fd = STDIN_FILENO;
+    redirects[0].src_fd = -1;
+    redirects[0].flags = O_RDONLY;
+    redirects[0].path = file;
+    memcpy(redirects + 1, cmd->redirects, cmd->redirect_count * sizeof(redirect_t));
+
+    *copy = *cmd;
+    copy->redirects = redirects;
+    copy->redirect_count = cmd->redirect_count + 1;
+    return copy;
+}
+
+// Текст конвейера для explain
+static void print_pipeline(FILE *out, const pipeline_t *pipeline) {
+    for (int i = 0; i < pipeline->stage_count; i++) {
+        const command_t *cmd = pipeline->stages[i];
+        if (i > 0) {
+            fprintf(out, " |");
+        }
+        for (int w = 0; w < cmd->word_num; w++) {
+            fprintf(out, "%s%s", i > 0 || w > 0 ? " " : "", cmd->words[w]);
+        }
+        for (int r = 0; r < cmd->redirect_count; r++) {
+            const redirect_t *redir = &cmd->redirects[r];
+            const char *sep = i > 0 || r > 0 || cmd->word_num > 0 ? " " : "";
+            switch (redir->op) {
+                case REDIR_OPEN:
+                    if (redir->fd == STDIN_FILENO) {
+                        fprintf(out, "%s< %s", sep, redir->path);
+                    } else {
+                        fprintf(out, "%s%s%s %s", sep, redir->fd == STDERR_FILENO ? "2" : "",
+                                (redir->flags & O_APPEND) ? ">>" : ">", redir->path);
+                    }
+                    break;
+                case REDIR_DUP:
+                    fprintf(out, "%s%d>&%d", sep, redir->fd, redir->src_fd);
+                    break;
+                case REDIR_CLOSE:
+                    fprintf(out, "%s%d>&-", sep, redir->fd);
+                    break;
+            }
+        }
+    }
+}
+
+static void explain(const char *rule, const pipeline_t *before, const pipeline_t *after) {
+    if (!opt_explain) {
+        return;
+    }
+    fflush(stdout);
+    fprintf(stderr, "optimize: %s: ", rule);
+    print_pipeline(stderr, before);
+    fprintf(stderr, "  =>  ");
+    print_pipeline(stderr, after);
+    fprintf(stderr, "\n");
+}
+
+// Оптимизированный конвейер во временной арене строки или исходный,
+// если переписывать нечего
+pipeline_t *optimize_pipeline(pipeline_t *pipeline) {
+    if (!opt_optimize || pipeline->stage_count < 2) {
+        return pipeline;
+    }
+
+    pipeline_t *current = pipeline;
+
+    // cat файл | cmd  ->  cmd < файл
+    if (leading_cat_file(current->stages[0], current->stages[1]) &&
+        !has_builtin_stage(current, 1, current->stage_count - 1)) {
+        pipeline_t *next = arena_alloc(line_arena, sizeof(pipeline_t));
+        command_t **stages = arena_alloc(line_arena, (current->stage_count - 1) * sizeof(command_t *));
+        command_t *first = redirect_from_file(current->stages[1], current->stages[0]->words[1]);
+        if (next != NULL && stages != NULL && first != NULL) {
+            stages[0] = first;
+            memcpy(stages + 1, current->stages + 2, (current->stage_count - 2) * sizeof(command_t *));
+            *next = *current;
+            next->stages = stages;
+            next->stage_count = current->stage_count - 1;
+            next->capacity = next->stage_count;
+            explain("cat file | cmd", current, next);
+            current = next;
+        }
+    }
+
+    // cmd | cat  ->  cmd. На терминал вывод cmd и cmd | cat различается:
+    // cmd видит терминал вместо pipe'а (ls печатает колонки).
+    // Статус cat - 0, его сохраняет force_success.
+    const command_t *last = current->stages[current->stage_count - 1];
+    if (current->stage_count >= 2 && stage_is_cat(last) && last->word_num == 1 &&
+        !has_builtin_stage(current, 0, current->stage_count - 2) && !isatty(STDOUT_FILENO)) {
+        pipeline_t *next = arena_alloc(line_arena, sizeof(pipeline_t));
+        if (next != NULL) {
+            *next = *current;
+            next->stage_count = current->stage_count - 1;
+            next->force_success = 1;
+            explain("cmd | cat", current, next);
+            current = next;
+        }
+    }
+
+    return current;
+}
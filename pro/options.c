@@ -0,0 +1,96 @@
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Опции shell, переключаемые встроенной командой set -o/+o.
+// Значения - обычные глобальные переменные, исполнитель читает их напрямую.
+// Числовые опции задаются как set -o имя=N; +o имя и N = 0 их выключают.
+
+int opt_spawn = 1;
+int opt_threads = 1;
+int opt_filters = 1;
+int opt_optimize = 0;
+int opt_explain = 0;
+int opt_maxjobs = 0;
+int opt_maxload = 0;
+int opt_minmem = 0;
+
+typedef struct {
+    const char *name;
+    int *value;
+    int numeric;            // Значение - число, а не on/off
+    const char *help;
+} shell_option_t;
+
+static const shell_option_t options[] = {
+    {"spawn", &opt_spawn, 0, "launch external commands with posix_spawn instead of fork"},
+    {"threads", &opt_threads, 0, "run thread-safe builtin pipeline stages on threads"},
+    {"filters", &opt_filters, 0, "run grep -F, wc -l, head and tail pipeline stages in-process"},
+    {"optimize", &opt_optimize, 0, "rewrite 'cat file | cmd' and 'cmd | cat' pipelines before running"},
+    {"explain", &opt_explain, 0, "report pipeline rewrites made by optimize on stderr"},
+    {"maxjobs", &opt_maxjobs, 1, "queue background jobs while N jobs are running"},
+    {"maxload", &opt_maxload, 1, "queue background jobs while the 1-minute load average is N or more"},
+    {"minmem", &opt_minmem, 1, "queue background jobs while less than N MiB of memory is available"},
+};
+
+#define OPTION_COUNT ((int)(sizeof(options) / sizeof(options[0])))
+
+static const shell_option_t *find_option(const char *name) {
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        if (strcmp(options[i].name, name) == 0) {
+            return &options[i];
+        }
+    }
+    return NULL;
+}
+
+// set -o/+o имя: -1 - нет такой опции, -2 - числовой опции нужно значение
+int set_option(const char *name, int value) {
+    const shell_option_t *opt = find_option(name);
+    if (opt == NULL) {
+        return -1;
+    }
+    if (opt->numeric && value) {
+        return -2;
+    }
+    *opt->value = value;
+    return 0;
+}
+
+// set -o имя=N: -1 - нет такой опции, -2 - опция не числовая,
+// -3 - значение не целое неотрицательное число
+int set_option_value(const char *name, size_t name_len, const char *text) {
+    const shell_option_t *opt = NULL;
+    for (int i = 0; i < OPTION_COUNT && opt == NULL; i++) {
+        if (strlen(options[i].name) == name_len && strncmp(options[i].name, name, name_len) == 0) {
+            opt = &options[i];
+        }
+    }
+    if (opt == NULL) {
+        return -1;
+    }
+    if (!opt->numeric) {
+        return -2;
+    }
+
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0 || value > 1000000) {
+        return -3;
+    }
+    *opt->value = (int)value;
+    return 0;
+}
+
+void print_options(void) {
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        char value[16];
+        if (options[i].numeric && *options[i].value) {
+            snprintf(value, sizeof(value), "%d", *options[i].value);
+        } else {
+            snprintf(value, sizeof(value), "%s", *options[i].value ? "on" : "off");
+        }
+        printf("%-12s %-4s %s\n", options[i].name, value, options[i].help);
+    }
+}
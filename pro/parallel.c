@@ -0,0 +1,537 @@
+#define _GNU_SOURCE
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+// parallel [-j N] [-k] [-v] команда [аргументы...] [::: вход...]
+//
+// Одна и та же команда для каждого входа: аргументы после ::: или
+// строки stdin (parallel gzip {} < list). {} в аргументах заменяется
+// входом; если {} нет, вход добавляется последним аргументом.
+//
+// Входы раздаются N слотам из общей очереди по порядку: освободившийся
+// слот берёт следующий вход, поэтому долгие и короткие задания
+// распределяются сами. Очереди на каждый слот с кражей работы здесь не
+// нужны: все слоты обслуживает один поток shell, очередь - это индекс
+// следующего входа, и за неё никто не соревнуется, а балансировку
+// даёт сама раздача по освобождению слота. Путь к команде ищется один раз, а каждый запуск
+// идёт через launch_command (posix_spawn при set -o spawn). Вывод
+// задания собирается из его pipe'а и печатается целиком, когда задание
+// завершилось (-k - в порядке входов), так что строки заданий не
+// перемешиваются. stderr заданий не перехватывается.
+//
+// Задания с ненулевым статусом перечисляются в stderr (-v - все), в
+// конце - итог: число заданий, время по часам и процессорное время
+// потомков. Код возврата - число неудачных заданий (не больше 101).
+
+#define PARALLEL_READ_SIZE 65536
+#define PARALLEL_MAX_FAILED 101
+
+// Вход и результат одного задания
+typedef struct {
+    const char *input;
+    char *output;               // Собранный stdout
+    size_t len;
+    size_t cap;
+    int status;                 // Код завершения в терминах shell
+    int done;
+} parallel_job_t;
+
+// Слот: запущенное задание
+typedef struct {
+    int job;                    // Номер входа или -1, если слот свободен
+    pid_t pid;
+    int out_fd;                 // Читающий конец pipe'а stdout или -1
+    int pidfd;                  // pidfd процесса или -1
+    int exited;
+} parallel_slot_t;
+
+typedef struct {
+    char **words;               // Команда и аргументы с {}
+    int word_count;
+    const char *full_path;
+    int null_fd;                // stdin заданий
+    int keep_order;             // -k
+    int verbose;                // -v
+    parallel_job_t *jobs;
+    int job_count;
+    int next_print;             // -k: первое ещё не выведенное задание
+    int failed;
+    int interrupted;            // Задание убито SIGINT: новых не запускаем
+    struct rusage usage;        // Сумма по всем заданиям
+} parallel_t;
+
+static double seconds(struct timeval tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Аргумент с {} -> вход
+static char *substitute(const char *word, const char *input) {
+    size_t count = 0;
+    for (const char *p = strstr(word, "{}"); p != NULL; p = strstr(p + 2, "{}")) {
+        count++;
+    }
+    if (count == 0) {
+        return strdup(word);
+    }
+
+    size_t input_len = strlen(input);
+    char *result = malloc(strlen(word) + count * input_len + 1);
+    if (result == NULL) {
+        return NULL;
+    }
+    char *out = result;
+    const char *p = word;
+    for (const char *brace = strstr(p, "{}"); brace != NULL; brace = strstr(p, "{}")) {
+        memcpy(out, p, brace - p);
+        out += brace - p;
+        memcpy(out, input, input_len);
+        out += input_len;
+        p = brace + 2;
+    }
+    strcpy(out, p);
+    return result;
+}
+
+static void free_words(char **words) {
+    for (int i = 0; words[i] != NULL; i++) {
+        free(words[i]);
+    }
+    free(words);
+}
+
+// argv задания: слова команды с подставленным входом
+static char **job_words(const parallel_t *par, const char *input) {
+    int has_braces = 0;
+    for (int i = 1; i < par->word_count && !has_braces; i++) {
+        has_braces = strstr(par->words[i], "{}") != NULL;
+    }
+
+    int count = par->word_count + (has_braces ? 0 : 1);
+    char **words = calloc(count + 1, sizeof(char *));
+    if (words == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < par->word_count; i++) {
+        words[i] = i == 0 ? strdup(par->words[0]) : substitute(par->words[i], input);
+        if (words[i] == NULL) {
+            free_words(words);
+            return NULL;
+        }
+    }
+    if (!has_braces && (words[count - 1] = strdup(input)) == NULL) {
+        free_words(words);
+        return NULL;
+    }
+    return words;
+}
+
+static void print_job_status(const parallel_t *par, int index) {
+    const parallel_job_t *job = &par->jobs[index];
+    fprintf(stderr, "parallel: [%d] exit %d: %s", index + 1, job->status, par->words[0]);
+    for (int i = 1; i < par->word_count; i++) {
+        fprintf(stderr, " %s", par->words[i]);
+    }
+    fprintf(stderr, " (%s)\n", job->input);
+}
+
+static void emit_job(parallel_t *par, int index) {
+    parallel_job_t *job = &par->jobs[index];
+    FILE *out = builtin_out();
+    if (job->len > 0) {
+        fwrite(job->output, 1, job->len, out);
+        fflush(out);
+    }
+    free(job->output);
+    job->output = NULL;
+    job->len = job->cap = 0;
+}
+
+// Задание завершилось и его вывод прочитан до EOF
+static void finish_job(parallel_t *par, int index) {
+    parallel_job_t *job = &par->jobs[index];
+    job->done = 1;
+    if (job->status != 0) {
+        par->failed++;
+    }
+    if (job->status != 0 || par->verbose) {
+        print_job_status(par, index);
+    }
+
+    if (!par->keep_order) {
+        emit_job(par, index);
+        return;
+    }
+    while (par->next_print < par->job_count && par->jobs[par->next_print].done) {
+        emit_job(par, par->next_print++);
+    }
+}
+
+static void record_exit(parallel_t *par, parallel_slot_t *slot, int status, const struct rusage *ru) {
+    parallel_job_t *job = &par->jobs[slot->job];
+    job->status = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT) {
+        par->interrupted = 1;
+    }
+    timeradd(&par->usage.ru_utime, &ru->ru_utime, &par->usage.ru_utime);
+    timeradd(&par->usage.ru_stime, &ru->ru_stime, &par->usage.ru_stime);
+    launch_waited(slot->pid);
+    slot->exited = 1;
+}
+
+// Ожидание процесса слота без pidfd (или после его готовности)
+static void reap_slot(parallel_t *par, parallel_slot_t *slot, int options) {
+    int status;
+    struct rusage ru;
+    pid_t pid;
+    do {
+        pid = wait4(slot->pid, &status, options, &ru);
+    } while (pid < 0 && errno == EINTR);
+
+    if (pid == slot->pid) {
+        record_exit(par, slot, status, &ru);
+    } else if (pid < 0) {
+        // Процесс собран кем-то другим: статус неизвестен
+        memset(&ru, 0, sizeof(ru));
+        record_exit(par, slot, 0, &ru);
+    }
+}
+
+static int start_job(parallel_t *par, parallel_slot_t *slot, int index) {
+    parallel_job_t *job = &par->jobs[index];
+    char **words = job_words(par, job->input);
+    if (words == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        perror("pipe");
+        free_words(words);
+        return -1;
+    }
+
+    int word_count = 0;
+    while (words[word_count] != NULL) {
+        word_count++;
+    }
+    command_t cmd = {.words = words, .word_num = word_count};
+
+    // Задания остаются в группе shell: Ctrl-C получают все сразу
+    pid_t pid = launch_command(&cmd, par->full_path, par->null_fd, fds[1], -1);
+    close(fds[1]);
+    free_words(words);
+    if (pid < 0) {
+        close(fds[0]);
+        job->status = 126;
+        finish_job(par, index);
+        return 0;
+    }
+
+    slot->job = index;
+    slot->pid = pid;
+    slot->out_fd = fds[0];
+    slot->pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    slot->exited = 0;
+    return 0;
+}
+
+// Чтение вывода задания; 0 - EOF
+static int read_output(parallel_slot_t *slot, parallel_job_t *job) {
+    if (job->cap - job->len < PARALLEL_READ_SIZE) {
+        size_t cap = job->cap ? job->cap * 2 : PARALLEL_READ_SIZE;
+        while (cap - job->len < PARALLEL_READ_SIZE) {
+            cap *= 2;
+        }
+        char *bigger = realloc(job->output, cap);
+        if (bigger == NULL) {
+            perror("realloc");
+            return 0;
+        }
+        job->output = bigger;
+        job->cap = cap;
+    }
+
+    ssize_t n = read(slot->out_fd, job->output + job->len, job->cap - job->len);
+    if (n < 0 && errno == EINTR) {
+        return 1;
+    }
+    if (n <= 0) {
+        return 0;
+    }
+    job->len += n;
+    return 1;
+}
+
+// Раздача входов слотам и сбор результатов
+static void run_jobs(parallel_t *par, parallel_slot_t *slots, int slot_count) {
+    struct pollfd *polls = malloc(2 * slot_count * sizeof(struct pollfd));
+    int *owners = malloc(2 * slot_count * sizeof(int));
+    if (polls == NULL || owners == NULL) {
+        perror("malloc");
+        free(polls);
+        free(owners);
+        return;
+    }
+
+    int next = 0;
+    int active = 0;
+    for (;;) {
+        for (int s = 0; s < slot_count && next < par->job_count && !par->interrupted; s++) {
+            if (slots[s].job < 0) {
+                if (start_job(par, &slots[s], next++) < 0) {
+                    par->interrupted = 1;
+                    break;
+                }
+                active += slots[s].job >= 0;
+            }
+        }
+        if (active == 0) {
+            break;
+        }
+
+        int count = 0;
+        for (int s = 0; s < slot_count; s++) {
+            if (slots[s].job < 0) {
+                continue;
+            }
+            if (slots[s].out_fd >= 0) {
+                polls[count] = (struct pollfd){.fd = slots[s].out_fd, .events = POLLIN};
+                owners[count++] = s;
+            }
+            if (slots[s].pidfd >= 0 && !slots[s].exited) {
+                polls[count] = (struct pollfd){.fd = slots[s].pidfd, .events = POLLIN};
+                owners[count++] = s;
+            }
+        }
+
+        if (count > 0 && poll(polls, count, -1) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            parallel_slot_t *slot = &slots[owners[i]];
+            if (polls[i].revents == 0) {
+                continue;
+            }
+            if (polls[i].fd == slot->out_fd) {
+                if (!read_output(slot, &par->jobs[slot->job])) {
+                    close(slot->out_fd);
+                    slot->out_fd = -1;
+                }
+            } else {
+                reap_slot(par, slot, WNOHANG);
+            }
+        }
+
+        // Задание готово, когда процесс завершился и pipe закрыт
+        for (int s = 0; s < slot_count; s++) {
+            parallel_slot_t *slot = &slots[s];
+            if (slot->job < 0 || slot->out_fd >= 0) {
+                continue;
+            }
+            if (!slot->exited) {
+                if (slot->pidfd >= 0) {
+                    continue;
+                }
+                reap_slot(par, slot, 0);    // Ядро без pidfd
+            }
+            if (slot->pidfd >= 0) {
+                close(slot->pidfd);
+            }
+            finish_job(par, slot->job);
+            slot->job = -1;
+            active--;
+        }
+    }
+
+    free(polls);
+    free(owners);
+}
+
+// Строки stdin как входы
+static int read_inputs(char ***lines_out, int *count_out) {
+    FILE *in = fdopen(dup(builtin_in()), "r");
+    if (in == NULL) {
+        perror("parallel: stdin");
+        return -1;
+    }
+
+    char **lines = NULL;
+    int count = 0, cap = 0;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    while ((len = getline(&line, &size, in)) >= 0) {
+        if (len > 0 && line[len - 1] == '\n') {
+            line[--len] = '\0';
+        }
+        if (len == 0) {
+            continue;
+        }
+        if (count == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **bigger = realloc(lines, cap * sizeof(char *));
+            if (bigger == NULL) {
+                perror("realloc");
+                break;
+            }
+            lines = bigger;
+        }
+        if ((lines[count] = strdup(line)) == NULL) {
+            perror("strdup");
+            break;
+        }
+        count++;
+    }
+    free(line);
+    fclose(in);
+
+    *lines_out = lines;
+    *count_out = count;
+    return 0;
+}
+
+static int usage(void) {
+    fprintf(stderr, "Usage: parallel [-j N] [-k] [-v] command [args...] [::: input...]\n");
+    fprintf(stderr, "       parallel [-j N] [-k] [-v] command [args...] < list\n");
+    return 2;
+}
+
+int parallel_builtin(char **args) {
+    parallel_t par;
+    memset(&par, 0, sizeof(par));
+
+    long slots_wanted = sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-k") == 0) {
+            par.keep_order = 1;
+        } else if (strcmp(args[i], "-v") == 0) {
+            par.verbose = 1;
+        } else if (strcmp(args[i], "-j") == 0 && args[i + 1] != NULL) {
+            char *end;
+            slots_wanted = strtol(args[++i], &end, 10);
+            if (*end != '\0' || slots_wanted <= 0 || slots_wanted > 4096) {
+                fprintf(stderr, "parallel: %s: invalid number of jobs\n", args[i]);
+                return 2;
+            }
+        } else if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        } else {
+            fprintf(stderr, "parallel: invalid option '%s'\n", args[i]);
+            return usage();
+        }
+    }
+    if (args[i] == NULL || strcmp(args[i], ":::") == 0) {
+        return usage();
+    }
+    if (slots_wanted <= 0) {
+        slots_wanted = 1;
+    }
+
+    par.words = args + i;
+    while (par.words[par.word_count] != NULL && strcmp(par.words[par.word_count], ":::") != 0) {
+        par.word_count++;
+    }
+
+    // Входы: после ::: или строки stdin
+    char **stdin_lines = NULL;
+    const char **inputs;
+    int input_count;
+    if (par.words[par.word_count] != NULL) {
+        inputs = (const char **)par.words + par.word_count + 1;
+        input_count = 0;
+        while (inputs[input_count] != NULL) {
+            input_count++;
+        }
+    } else {
+        if (read_inputs(&stdin_lines, &input_count) < 0) {
+            return 1;
+        }
+        inputs = (const char **)stdin_lines;
+    }
+
+    par.full_path = get_full_path(par.words[0]);
+    if (par.full_path == NULL) {
+        fprintf(stderr, "parallel: %s: command not found\n", par.words[0]);
+        for (int j = 0; j < input_count && stdin_lines != NULL; j++) {
+            free(stdin_lines[j]);
+        }
+        free(stdin_lines);
+        return 127;
+    }
+
+    int slot_count = slots_wanted < input_count ? (int)slots_wanted : input_count;
+    par.job_count = input_count;
+    par.jobs = calloc(input_count > 0 ? input_count : 1, sizeof(parallel_job_t));
+    parallel_slot_t *slots = calloc(slot_count > 0 ? slot_count : 1, sizeof(parallel_slot_t));
+    par.null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (par.jobs == NULL || slots == NULL || par.null_fd < 0) {
+        perror("parallel");
+        free(par.jobs);
+        free(slots);
+        if (par.null_fd >= 0) close(par.null_fd);
+        return 1;
+    }
+    for (int j = 0; j < input_count; j++) {
+        par.jobs[j].input = inputs[j];
+    }
+    for (int s = 0; s < slot_count; s++) {
+        slots[s].job = -1;
+    }
+
+    // Вывод shell до заданий, задания до итога
+    fflush(builtin_out());
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_jobs(&par, slots, slot_count);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // -k после прерывания: вывод заданий за пропущенными входами
+    for (int j = par.next_print; par.keep_order && j < input_count; j++) {
+        if (par.jobs[j].done) {
+            emit_job(&par, j);
+        }
+    }
+
+    double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double user = seconds(par.usage.ru_utime);
+    double sys = seconds(par.usage.ru_stime);
+    int finished = 0;
+    for (int j = 0; j < input_count; j++) {
+        finished += par.jobs[j].done;
+    }
+    fprintf(stderr, "parallel: %d jobs, %d failed, %d slots: wall %.3fs, cpu %.3fs (user %.3fs, sys %.3fs)\n",
+            finished, par.failed, slot_count, wall, user + sys, user, sys);
+
+    for (int j = 0; j < input_count; j++) {
+        free(par.jobs[j].output);
+        if (stdin_lines != NULL) {
+            free(stdin_lines[j]);
+        }
+    }
+    free(stdin_lines);
+    free(par.jobs);
+    free(slots);
+    close(par.null_fd);
+
+    if (par.interrupted && finished < input_count) {
+        return 128 + SIGINT;
+    }
+    return par.failed > PARALLEL_MAX_FAILED ? PARALLEL_MAX_FAILED : par.failed;
+}
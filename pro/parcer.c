@@ -4,782 +4,568 @@
 #include <string.h>
 #include <ctype.h>
 
-static const char DELIMITERS[] = " \t\n\r";
-
-void process_redirections_and_pipes(command_t *cmd, char **words, int *word_num);
-
 int is_special_char(char c) {
-    const char *special_chars = "@#%!&$^;:,(){}[]";
-    return (strchr(special_chars, c) != NULL);
+    return (char_class[(unsigned char)c] & CH_SPECIAL) != 0;
 }
 
-int is_redirection_char(char *str) {
-    return (strcmp(str, ">") == 0 || strcmp(str, ">>") == 0 || 
-            strcmp(str, "<") == 0 || strcmp(str, "2>") == 0 || 
-            strcmp(str, "2>>") == 0 || strcmp(str, "2>&1") == 0);
+int is_redirection_kind(token_kind_t kind) {
+    return kind >= TOK_REDIR_IN && kind <= TOK_REDIR_MERGE;
 }
 
-int is_command_separator(const char *str) {
-    return (strcmp(str, ";") == 0 || strcmp(str, "&&") == 0 || strcmp(str, "||") == 0);
+int get_separator_type(token_kind_t kind) {
+    switch (kind) {
+        case TOK_SEMI:   return 0;
+        case TOK_AND_IF: return 1;
+        case TOK_OR_IF:  return 2;
+        default:         return -1;
+    }
 }
 
-int get_separator_type(const char *sep) {
-    if (strcmp(sep, ";") == 0) return 0;
-    if (strcmp(sep, "&&") == 0) return 1;
-    if (strcmp(sep, "||") == 0) return 2;
-    return -1;
+// Распознавание оператора, начинающегося в p. Возвращает его длину
+// (0 - не оператор) и вид в *kind. 2>, 2>> и 2>&1 распознаются
+// только в начале слова, как в bash.
+static size_t operator_kind(const char *p, int at_word_start, token_kind_t *kind) {
+    if (at_word_start && p[0] == '2' && p[1] == '>') {
+        if (p[2] == '&' && p[3] == '1') { *kind = TOK_REDIR_MERGE; return 4; }
+        if (p[2] == '>') { *kind = TOK_REDIR_ERR_APPEND; return 3; }
+        *kind = TOK_REDIR_ERR;
+        return 2;
+    }
+
+    switch (p[0]) {
+        case '>':
+            if (p[1] == '>') { *kind = TOK_REDIR_APPEND; return 2; }
+            *kind = TOK_REDIR_OUT;
+            return 1;
+        case '<':
+            if (p[1] == '<') { *kind = TOK_HEREDOC; return 2; }
+            *kind = TOK_REDIR_IN;
+            return 1;
+        case '&':
+            if (p[1] == '&') { *kind = TOK_AND_IF; return 2; }
+            *kind = TOK_AMP;
+            return 1;
+        case '|':
+            if (p[1] == '|') { *kind = TOK_OR_IF; return 2; }
+            *kind = TOK_PIPE;
+            return 1;
+        case ';':
+            *kind = TOK_SEMI;
+            return 1;
+        default:
+            return 0;
+    }
 }
 
-command_t *parse_input(const char *input) {
-    if (input == NULL || strlen(input) == 0) {
-        return NULL;
+static int push_token(token_stream_t *ts, size_t offset, size_t length, token_kind_t kind) {
+    if (ts->count == ts->capacity) {
+        int new_capacity = ts->capacity > 0 ? ts->capacity * 2 : 16;
+        token_t *grown = arena_realloc(ts->arena, ts->tokens, ts->capacity * sizeof(token_t),
+                                       new_capacity * sizeof(token_t));
+        if (grown == NULL) {
+            return -1;
+        }
+        ts->tokens = grown;
+        ts->capacity = new_capacity;
     }
 
-    command_t *cmd = malloc(sizeof(command_t));
-    if (cmd == NULL) {
-        perror("malloc");
+    ts->tokens[ts->count].offset = offset;
+    ts->tokens[ts->count].length = length;
+    ts->tokens[ts->count].kind = kind;
+    ts->count++;
+    return 0;
+}
+
+// Разбиение строки на токены без копирования каждого слова.
+// Строка копируется один раз; кавычки и экранирование снимаются прямо
+// в этой копии (результат никогда не длиннее исходной строки), а токены
+// хранятся как срезы (смещение, длина, вид). Вся память берётся из
+// арены и освобождается вместе с ней.
+token_stream_t *tokenize(const char *input, arena_t *arena) {
+    if (input == NULL) {
         return NULL;
     }
 
-    // Инициализация структуры с новыми полями
-    cmd->words = NULL;
-    cmd->word_num = 0;
-    cmd->fonius = 0;
-    cmd->input_file = NULL;
-    cmd->output_file = NULL;
-    cmd->error_file = NULL;    
-    cmd->append_output = 0;
-    cmd->append_error = 0;     
-    cmd->merge_output = 0;     
-    cmd->pipeline = NULL;
-    cmd->pipeline_count = 0;
-
-    char *line = strdup(input);
-    if (line == NULL) {
-        perror("strdup");
-        free(cmd);
+    size_t input_len = strlen(input);
+    token_stream_t *ts = arena_alloc(arena, sizeof(token_stream_t));
+    if (ts == NULL) {
         return NULL;
     }
 
-    char *ptr = line;
-    int in_quotes = 0;
-    int escape_next = 0;
-    char current_token[MAX_INPUT_LENGTH];
-    int token_pos = 0;
-
-    // Временный список токенов
-    char **temp_words = malloc(MAX_WORDS * sizeof(char*));
-    if (temp_words == NULL) {
-        perror("malloc");
-        free(line);
-        free(cmd);
+    ts->arena = arena;
+    ts->text = arena_alloc(arena, input_len + 1);
+    ts->tokens = NULL;
+    ts->count = 0;
+    ts->capacity = 0;
+    if (ts->text == NULL) {
         return NULL;
     }
-    int temp_count = 0;
 
-    while (*ptr != '\0' && temp_count < MAX_WORDS) {
-        // Обработка экранирования
-        if (escape_next) {
-            if (token_pos < MAX_INPUT_LENGTH - 1) {
-                current_token[token_pos++] = *ptr;
+    const char *ptr = input;
+    const char *end = input + input_len;
+    char *out = ts->text;
+    size_t word_start = 0;
+    int in_word = 0;
+    char quote = 0;
+
+    while (ptr < end) {
+        if (quote) {
+            // Внутри кавычек - все символы обычные, копируем до закрывающей целиком
+            const char *close = memchr(ptr, quote, end - ptr);
+            size_t run = (close != NULL ? close : end) - ptr;
+            memcpy(out, ptr, run);
+            out += run;
+            ptr += run;
+            if (close != NULL) {
+                quote = 0;
+                ptr++;
             }
-            escape_next = 0;
-            ptr++;
             continue;
         }
 
-        // Обработка обратного слеша для экранирования
-        if (*ptr == '\\' && !in_quotes) {
-            escape_next = 1;
-            ptr++;
-            continue;
-        }
+        unsigned char cls = char_class[(unsigned char)*ptr];
 
-        // Обработка кавычек
-        if (*ptr == '"') {
-            in_quotes = !in_quotes;
+        if (cls & CH_DELIM) {
+            if (in_word) {
+                if (push_token(ts, word_start, (out - ts->text) - word_start, TOK_WORD) < 0) {
+                    return NULL;
+                }
+                in_word = 0;
+            }
             ptr++;
             continue;
         }
 
-        if (in_quotes) {
-            // Внутри кавычек - все символы обычные
-            if (token_pos < MAX_INPUT_LENGTH - 1) {
-                current_token[token_pos++] = *ptr;
-            }
-            ptr++;
-        } else {
-            // ПРОВЕРКА НА ДВОЙНЫЕ СИМВОЛЫ ПЕРЕНАПРАВЛЕНИЯ В ПЕРВУЮ ОЧЕРЕДЬ
-            // Проверка на >> (должна быть ПЕРЕД проверкой на одиночный >)
-            if (*ptr == '>' && *(ptr + 1) == '>') {
-                // Сохраняем текущий токен, если есть
-                if (token_pos > 0) {
-                    current_token[token_pos] = '\0';
-                    if (temp_count < MAX_WORDS - 1) {
-                        temp_words[temp_count++] = strdup(current_token);
-                    }
-                    token_pos = 0;
-                }
-                
-                // Сохраняем >> как один токен
-                if (temp_count < MAX_WORDS - 1) {
-                    temp_words[temp_count++] = strdup(">>");
-                }
-                
-                ptr += 2; // Пропускаем два символа
-                continue;
-            }
-            
-            // Проверка на << (heredoc)
-            if (*ptr == '<' && *(ptr + 1) == '<') {
-                // Сохраняем текущий токен, если есть
-                if (token_pos > 0) {
-                    current_token[token_pos] = '\0';
-                    if (temp_count < MAX_WORDS - 1) {
-                        temp_words[temp_count++] = strdup(current_token);
-                    }
-                    token_pos = 0;
-                }
-                
-                if (temp_count < MAX_WORDS - 1) {
-                    temp_words[temp_count++] = strdup("<<");
-                }
-                
-                ptr += 2;
-                continue;
-            }
-            
-            // Проверка на двойные символы (&& и ||)
-            if ((*ptr == '&' && *(ptr + 1) == '&') || 
-                (*ptr == '|' && *(ptr + 1) == '|')) {
-                
-                // Сохраняем текущий токен, если есть
-                if (token_pos > 0) {
-                    current_token[token_pos] = '\0';
-                    if (temp_count < MAX_WORDS - 1) {
-                        temp_words[temp_count++] = strdup(current_token);
+        // Оператор возможен только на символе-операторе или в начале слова (2>)
+        if (!in_word || (cls & CH_OPERATOR)) {
+            token_kind_t op_kind;
+            size_t op_len = operator_kind(ptr, !in_word, &op_kind);
+            if (op_len > 0) {
+                if (in_word) {
+                    if (push_token(ts, word_start, (out - ts->text) - word_start, TOK_WORD) < 0) {
+                        return NULL;
                     }
-                    token_pos = 0;
+                    in_word = 0;
                 }
-                
-                // Сохраняем двойной символ как один токен
-                if (temp_count < MAX_WORDS - 1) {
-                    char double_token[3] = {*ptr, *(ptr + 1), '\0'};
-                    temp_words[temp_count++] = strdup(double_token);
+                size_t op_start = out - ts->text;
+                memcpy(out, ptr, op_len);
+                out += op_len;
+                ptr += op_len;
+                if (push_token(ts, op_start, op_len, op_kind) < 0) {
+                    return NULL;
                 }
-                
-                ptr += 2; // Пропускаем два символа
                 continue;
             }
-            
-            // Проверка на перенаправления stderr (2>, 2>>, 2>&1)
-            if ((*ptr == '2' && *(ptr + 1) == '>' && *(ptr + 2) == '&' && *(ptr + 3) == '1')) {
-                // Обработка 2>&1
-                if (token_pos > 0) {
-                    current_token[token_pos] = '\0';
-                    if (temp_count < MAX_WORDS - 1) {
-                        temp_words[temp_count++] = strdup(current_token);
-                    }
-                    token_pos = 0;
-                }
-                
-                if (temp_count < MAX_WORDS - 1) {
-                    temp_words[temp_count++] = strdup("2>&1");
-                }
-                
-                ptr += 4;
-                continue;
-            } else if ((*ptr == '2' && *(ptr + 1) == '>' && *(ptr + 2) == '>')) {
-                // Обработка 2>>
-                if (token_pos > 0) {
-                    current_token[token_pos] = '\0';
-                    if (temp_count < MAX_WORDS - 1) {
-                        temp_words[temp_count++] = strdup(current_token);
-                    }
-                    token_pos = 0;
-                }
-                
-                if (temp_count < MAX_WORDS - 1) {
-                    temp_words[temp_count++] = strdup("2>>");
-                }
-                
-                ptr += 3;
-                continue;
-            } else if ((*ptr == '2' && *(ptr + 1) == '>')) {
-                // Обработка 2>
-                if (token_pos > 0) {
-                    current_token[token_pos] = '\0';
-                    if (temp_count < MAX_WORDS - 1) {
-                        temp_words[temp_count++] = strdup(current_token);
-                    }
-                    token_pos = 0;
-                }
-                
-                if (temp_count < MAX_WORDS - 1) {
-                    temp_words[temp_count++] = strdup("2>");
-                }
-                
-                ptr += 2;
-                continue;
+
+            if (!in_word) {
+                word_start = out - ts->text;
+                in_word = 1;
             }
+        }
 
-            // Проверка на одиночные символы перенаправления и разделители
-            if (*ptr == '>' || *ptr == '<' || *ptr == '|' || *ptr == '&' || *ptr == ';') {
-                // Сохраняем текущий токен, если есть
-                if (token_pos > 0) {
-                    current_token[token_pos] = '\0';
-                    if (temp_count < MAX_WORDS - 1) {
-                        temp_words[temp_count++] = strdup(current_token);
-                    }
-                    token_pos = 0;
-                }
-                // Сохраняем специальный символ как отдельный токен
-                if (temp_count < MAX_WORDS - 1) {
-                    char special_token[2] = {*ptr, '\0'};
-                    temp_words[temp_count++] = strdup(special_token);
-                }
-                ptr++;
-            } else if (strchr(DELIMITERS, *ptr)) {
-                // Сохраняем текущий токен, если есть
-                if (token_pos > 0) {
-                    current_token[token_pos] = '\0';
-                    if (temp_count < MAX_WORDS - 1) {
-                        temp_words[temp_count++] = strdup(current_token);
-                    }
-                    token_pos = 0;
-                }
-                ptr++;
+        if (cls & CH_ESCAPE) {
+            // Экранированный символ всегда входит в слово
+            if (ptr + 1 < end) {
+                *out++ = ptr[1];
+                ptr += 2;
             } else {
-                // Обычный символ - добавляем в текущий токен
-                if (token_pos < MAX_INPUT_LENGTH - 1) {
-                    current_token[token_pos++] = *ptr;
-                }
                 ptr++;
             }
+            continue;
         }
-    }
 
-    // Последний токен
-    if (token_pos > 0) {
-        current_token[token_pos] = '\0';
-        if (temp_count < MAX_WORDS - 1) {
-            temp_words[temp_count++] = strdup(current_token);
+        if (cls & CH_QUOTE) {
+            quote = *ptr++;
+            continue;
         }
+
+        // Серия обычных символов копируется целиком (векторный поиск границы)
+        size_t run = scan_word_run(ptr, end);
+        if (run == 0) {
+            run = 1;
+        }
+        memcpy(out, ptr, run);
+        out += run;
+        ptr += run;
     }
 
-    free(line);
-
-    // Обработка фонового режима - ТОЛЬКО одиночный & в конце
-    if (temp_count > 0) {
-        // Проверяем, что & не в середине как одиночный символ
-        for (int i = 0; i < temp_count; i++) {
-            if (strcmp(temp_words[i], "&") == 0) {
-                if (i == temp_count - 1) {
-                    // & в конце - это фоновый режим
-                    cmd->fonius = 1;
-                    free(temp_words[i]);
-                    // Сдвигаем остальные элементы
-                    for (int j = i; j < temp_count - 1; j++) {
-                        temp_words[j] = temp_words[j + 1];
-                    }
-                    temp_count--;
-                } else {
-                    // & в середине - это ошибка (если это не часть &&)
-                    fprintf(stderr, "Error: '&' must be at the end of command\n");
-                    // Освобождаем временную память
-                    for (int j = 0; j < temp_count; j++) {
-                        free(temp_words[j]);
-                    }
-                    free(temp_words);
-                    free(cmd);
-                    return NULL;
-                }
-                break;
-            }
+    // Последний токен (незакрытая кавычка закрывается концом строки)
+    if (in_word) {
+        if (push_token(ts, word_start, (out - ts->text) - word_start, TOK_WORD) < 0) {
+            return NULL;
         }
     }
+    *out = '\0';
 
-    // Обработка перенаправлений и конвейеров
-    process_redirections_and_pipes(cmd, temp_words, &temp_count);
+    return ts;
+}
 
-    // Копируем токены в структуру команды
-    cmd->words = malloc((temp_count + 1) * sizeof(char*));
-    if (cmd->words == NULL) {
-        perror("malloc");
-        for (int i = 0; i < temp_count; i++) {
-            free(temp_words[i]);
-        }
-        free(temp_words);
-        free(cmd);
+// Материализация токенов [first, first + count) в массив строк.
+// Все строки лежат в одном блоке арены, поэтому на команду приходится
+// ровно два выделения независимо от числа аргументов.
+char **materialize_words(const token_stream_t *ts, int first, int count, arena_t *arena) {
+    size_t total = 0;
+    for (int i = first; i < first + count; i++) {
+        total += ts->tokens[i].length + 1;
+    }
+
+    char **words = arena_alloc(arena, (count + 1) * sizeof(char *));
+    char *storage = arena_alloc(arena, total);
+    if (words == NULL || storage == NULL) {
         return NULL;
     }
 
-    for (int i = 0; i < temp_count; i++) {
-        cmd->words[i] = temp_words[i];
+    char *dst = storage;
+    for (int i = 0; i < count; i++) {
+        const token_t *tok = &ts->tokens[first + i];
+        memcpy(dst, ts->text + tok->offset, tok->length);
+        dst[tok->length] = '\0';
+        words[i] = dst;
+        dst += tok->length + 1;
     }
-    cmd->words[temp_count] = NULL;
-    cmd->word_num = temp_count;
+    words[count] = NULL;
 
-    free(temp_words);
-    return cmd;
+    return words;
 }
 
-// Вспомогательная функция для удаления токенов
-void remove_words(char **words, int *count, int start, int num) {
-    if (start < 0 || start >= *count || num <= 0) return;
-    
-    // Освобождаем удаляемые токены
-    for (int i = start; i < start + num && i < *count; i++) {
-        free(words[i]);
+// Увеличение динамического массива при необходимости
+static int ensure_capacity(arena_t *arena, void **items, int *capacity, int count, size_t item_size) {
+    if (count < *capacity) {
+        return 0;
     }
-    
-    // Сдвигаем оставшиеся токены
-    for (int i = start; i < *count - num; i++) {
-        words[i] = words[i + num];
-    }
-    
-    *count -= num;
-}
 
-// НОВАЯ ФУНКЦИЯ: копирование информации о перенаправлениях
-void copy_redirections(command_t *dest, const command_t *src) {
-    if (src->input_file) dest->input_file = strdup(src->input_file);
-    if (src->output_file) dest->output_file = strdup(src->output_file);
-    if (src->error_file) dest->error_file = strdup(src->error_file);
-    dest->append_output = src->append_output;
-    dest->append_error = src->append_error;
-    dest->merge_output = src->merge_output;
-    dest->fonius = src->fonius;
-}
-
-// Парсинг ввода с разделителями команд
-command_sequence_t *parse_input_with_separators(const char *input) {
-    if (input == NULL || strlen(input) == 0) {
-        return NULL;
+    int new_capacity = *capacity > 0 ? *capacity * 2 : 4;
+    void *grown = arena_realloc(arena, *items, *capacity * item_size, new_capacity * item_size);
+    if (grown == NULL) {
+        return -1;
     }
+    *items = grown;
+    *capacity = new_capacity;
+    return 0;
+}
 
-    // Сначала парсим всю строку как обычно
-    command_t *full_cmd = parse_input(input);
-    if (full_cmd == NULL) {
+// Построение простой команды из токенов [start, end).
+// В диапазоне только слова и перенаправления - управляющие операторы
+// уже обработаны в parse_line. Перенаправления извлекаются за один
+// проход: слова уплотняются на месте, а операции над дескрипторами
+// складываются в упорядоченный список.
+static command_t *build_simple_command(const token_stream_t *ts, int start, int end, arena_t *arena) {
+    command_t *cmd = arena_alloc(arena, sizeof(command_t));
+    if (cmd == NULL) {
         return NULL;
     }
 
-    command_sequence_t *seq = malloc(sizeof(command_sequence_t));
-    if (seq == NULL) {
-        perror("malloc");
-        free_command(full_cmd);
-        return NULL;
+    int count = end - start;
+    int redirect_count = 0;
+    for (int i = start; i < end; i++) {
+        if (ts->tokens[i].kind != TOK_WORD) {
+            redirect_count++;
+        }
     }
 
-    seq->commands = NULL;
-    seq->command_count = 0;
-    seq->separators = NULL;
+    cmd->words = NULL;
+    cmd->word_num = 0;
+    cmd->fonius = 0;
+    cmd->redirects = NULL;
+    cmd->redirect_count = 0;
 
-    // Временные массивы
-    command_t **temp_commands = malloc(MAX_WORDS * sizeof(command_t *));
-    int *temp_separators = malloc(MAX_WORDS * sizeof(int));
-    
-    if (temp_commands == NULL || temp_separators == NULL) {
-        perror("malloc");
-        free_command(full_cmd);
-        free(seq);
-        free(temp_commands);
-        free(temp_separators);
+    // Строки слов (и имён файлов) создаются один раз, единым блоком
+    cmd->words = materialize_words(ts, start, count, arena);
+    if (cmd->words == NULL) {
         return NULL;
     }
+    if (redirect_count > 0) {
+        cmd->redirects = arena_alloc(arena, redirect_count * sizeof(redirect_t));
+        if (cmd->redirects == NULL) {
+            return NULL;
+        }
+    }
 
-    int cmd_start = 0;
-    int seq_index = 0;
-
-    for (int i = 0; i <= full_cmd->word_num; i++) {
-        // Проверяем на разделитель или конец
-        if (i == full_cmd->word_num || is_command_separator(full_cmd->words[i])) {
-            // Создаем команду из сегмента
-            if (i > cmd_start) {
-                command_t *sub_cmd = malloc(sizeof(command_t));
-                if (sub_cmd == NULL) {
-                    perror("malloc");
-                    // Освобождаем уже созданные команды
-                    for (int j = 0; j < seq_index; j++) {
-                        free_command(temp_commands[j]);
-                    }
-                    free_command(full_cmd);
-                    free(seq);
-                    free(temp_commands);
-                    free(temp_separators);
-                    return NULL;
-                }
-
-                // Инициализируем подкоманду
-                sub_cmd->words = NULL;
-                sub_cmd->word_num = 0;
-                sub_cmd->fonius = 0;
-                sub_cmd->input_file = NULL;
-                sub_cmd->output_file = NULL;
-                sub_cmd->error_file = NULL;
-                sub_cmd->append_output = 0;
-                sub_cmd->append_error = 0;
-                sub_cmd->merge_output = 0;
-                sub_cmd->pipeline = NULL;
-                sub_cmd->pipeline_count = 0;
-
-                // Копируем слова
-                sub_cmd->word_num = i - cmd_start;
-                sub_cmd->words = malloc((sub_cmd->word_num + 1) * sizeof(char *));
-                if (sub_cmd->words == NULL) {
-                    perror("malloc");
-                    free(sub_cmd);
-                    for (int j = 0; j < seq_index; j++) {
-                        free_command(temp_commands[j]);
-                    }
-                    free_command(full_cmd);
-                    free(seq);
-                    free(temp_commands);
-                    free(temp_separators);
-                    return NULL;
-                }
+    int word_num = 0;
+    for (int i = 0; i < count; i++) {
+        token_kind_t kind = ts->tokens[start + i].kind;
 
-                for (int j = cmd_start; j < i; j++) {
-                    sub_cmd->words[j - cmd_start] = strdup(full_cmd->words[j]);
-                    if (sub_cmd->words[j - cmd_start] == NULL) {
-                        perror("strdup");
-                        for (int k = cmd_start; k < j; k++) {
-                            free(sub_cmd->words[k - cmd_start]);
-                        }
-                        free(sub_cmd->words);
-                        free(sub_cmd);
-                        for (int k = 0; k < seq_index; k++) {
-                            free_command(temp_commands[k]);
-                        }
-                        free_command(full_cmd);
-                        free(seq);
-                        free(temp_commands);
-                        free(temp_separators);
-                        return NULL;
-                    }
-                }
-                sub_cmd->words[sub_cmd->word_num] = NULL;
+        if (kind == TOK_WORD) {
+            cmd->words[word_num++] = cmd->words[i];
+            continue;
+        }
 
-                // ВАЖНО: Копируем перенаправления из оригинальной команды
-                // Это позволяет командам в последовательности наследовать перенаправления
-                copy_redirections(sub_cmd, full_cmd);
+        redirect_t *r = &cmd->redirects[cmd->redirect_count];
 
-                temp_commands[seq_index] = sub_cmd;
+        if (kind == TOK_REDIR_MERGE) {
+            // Объединение stderr с stdout
+            r->op = REDIR_DUP;
+            r->fd = STDERR_FILENO;
+            r->src_fd = STDOUT_FILENO;
+            r->flags = 0;
+            r->path = NULL;
+            cmd->redirect_count++;
+            continue;
+        }
 
-                // Сохраняем разделитель (если есть)
-                if (i < full_cmd->word_num) {
-                    temp_separators[seq_index] = get_separator_type(full_cmd->words[i]);
-                }
-                
-                seq_index++;
-            }
-            cmd_start = i + 1;
+        if (kind == TOK_HEREDOC) {
+            fprintf(stderr, "Error: '<<' is not supported\n");
+            return NULL;
         }
-    }
 
-    // Копируем в итоговую структуру
-    seq->command_count = seq_index;
-    seq->commands = malloc(seq_index * sizeof(command_t *));
-    seq->separators = malloc((seq_index > 0 ? seq_index - 1 : 0) * sizeof(int));
-    
-    if (seq->commands == NULL || (seq_index > 0 && seq->separators == NULL)) {
-        perror("malloc");
-        for (int i = 0; i < seq_index; i++) {
-            free_command(temp_commands[i]);
+        // Проверяем, что за оператором идёт имя файла
+        if (i + 1 >= count) {
+            fprintf(stderr, "Error: expected filename after '%s'\n", cmd->words[i]);
+            return NULL;
         }
-        free_command(full_cmd);
-        free(seq);
-        free(temp_commands);
-        free(temp_separators);
-        return NULL;
-    }
+        if (ts->tokens[start + i + 1].kind != TOK_WORD) {
+            fprintf(stderr, "Error: filename cannot be special character '%s'\n", cmd->words[i + 1]);
+            return NULL;
+        }
+
+        r->op = REDIR_OPEN;
+        r->src_fd = -1;
+        r->path = cmd->words[i + 1];
 
-    for (int i = 0; i < seq_index; i++) {
-        seq->commands[i] = temp_commands[i];
-        if (i < seq_index - 1) {
-            seq->separators[i] = temp_separators[i];
+        switch (kind) {
+            case TOK_REDIR_IN:
+                r->fd = STDIN_FILENO;
+                r->flags = O_RDONLY;
+                break;
+            case TOK_REDIR_OUT:
+                r->fd = STDOUT_FILENO;
+                r->flags = O_WRONLY | O_CREAT | O_TRUNC;
+                break;
+            case TOK_REDIR_APPEND:
+                r->fd = STDOUT_FILENO;
+                r->flags = O_WRONLY | O_CREAT | O_APPEND;
+                break;
+            case TOK_REDIR_ERR:
+                r->fd = STDERR_FILENO;
+                r->flags = O_WRONLY | O_CREAT | O_TRUNC;
+                break;
+            default: // TOK_REDIR_ERR_APPEND
+                r->fd = STDERR_FILENO;
+                r->flags = O_WRONLY | O_CREAT | O_APPEND;
+                break;
         }
+        cmd->redirect_count++;
+        i++;  // Имя файла уже использовано
     }
 
-    free(temp_commands);
-    free(temp_separators);
-    free_command(full_cmd);
+    cmd->words[word_num] = NULL;
+    cmd->word_num = word_num;
 
-    return seq;
+    return cmd;
 }
 
-// Освобождение последовательности команд
-void free_command_sequence(command_sequence_t *seq) {
-    if (seq == NULL) return;
-    
-    for (int i = 0; i < seq->command_count; i++) {
-        free_command(seq->commands[i]);
+static int append_stage(arena_t *arena, pipeline_t *pipeline, command_t *cmd) {
+    if (ensure_capacity(arena, (void **)&pipeline->stages, &pipeline->capacity,
+                        pipeline->stage_count, sizeof(command_t *)) < 0) {
+        return -1;
     }
-    free(seq->commands);
-    free(seq->separators);
-    free(seq);
+    pipeline->stages[pipeline->stage_count++] = cmd;
+    return 0;
 }
 
-// Отладка последовательности команд
-void print_command_sequence(const command_sequence_t *seq) {
-    if (seq == NULL) {
-        printf("Command sequence: NULL\n");
-        return;
+static int append_pipeline(arena_t *arena, and_or_t *and_or, pipeline_t *pipeline, int connector) {
+    int old_capacity = and_or->capacity;
+    if (ensure_capacity(arena, (void **)&and_or->pipelines, &and_or->capacity,
+                        and_or->count, sizeof(pipeline_t *)) < 0) {
+        return -1;
     }
-    
-    printf("Command sequence (%d commands):\n", seq->command_count);
-    for (int i = 0; i < seq->command_count; i++) {
-        printf("  Command %d: ", i + 1);
-        for (int j = 0; j < seq->commands[i]->word_num; j++) {
-            printf("[%s] ", seq->commands[i]->words[j]);
-        }
-        printf("\n");
-        
-        // Выводим информацию о перенаправлениях
-        if (seq->commands[i]->input_file) 
-            printf("    Input: %s\n", seq->commands[i]->input_file);
-        if (seq->commands[i]->output_file) 
-            printf("    Output: %s (%s)\n", seq->commands[i]->output_file, 
-                   seq->commands[i]->append_output ? "append" : "trunc");
-        if (seq->commands[i]->error_file) 
-            printf("    Error: %s (%s)\n", seq->commands[i]->error_file, 
-                   seq->commands[i]->append_error ? "append" : "trunc");
-        if (seq->commands[i]->merge_output) 
-            printf("    Merge: stderr to stdout\n");
-        
-        if (i < seq->command_count - 1) {
-            const char *sep_name;
-            switch (seq->separators[i]) {
-                case 0: sep_name = ";"; break;
-                case 1: sep_name = "&&"; break;
-                case 2: sep_name = "||"; break;
-                default: sep_name = "?"; break;
-            }
-            printf("  Separator: %s\n", sep_name);
+    // Связок всегда на одну меньше, чем конвейеров, но массив растёт вместе с ними
+    int *grown = and_or->connectors;
+    if (and_or->capacity != old_capacity) {
+        grown = arena_realloc(arena, and_or->connectors, old_capacity * sizeof(int),
+                              and_or->capacity * sizeof(int));
+        if (grown == NULL) {
+            return -1;
         }
     }
+    and_or->connectors = grown;
+    and_or->pipelines[and_or->count] = pipeline;
+    and_or->connectors[and_or->count] = connector;
+    and_or->count++;
+    return 0;
 }
 
-void process_redirections_and_pipes(command_t *cmd, char **words, int *word_num) {
-    int i = 0;
-    
-    while (i < *word_num) {
-        // Пропускаем пустые слова и разделители команд
-        if (words[i] == NULL || strlen(words[i]) == 0 || is_command_separator(words[i])) {
-            i++;
+static int append_and_or(arena_t *arena, command_list_t *list, and_or_t *and_or) {
+    if (ensure_capacity(arena, (void **)&list->lists, &list->capacity,
+                        list->count, sizeof(and_or_t *)) < 0) {
+        return -1;
+    }
+    list->lists[list->count++] = and_or;
+    return 0;
+}
+
+// Разбор строки в дерево за один проход по токенам:
+// список (; &) -> связка (&& ||) -> конвейер (|) -> простая команда.
+command_list_t *parse_line(const char *input) {
+    if (input == NULL) {
+        return NULL;
+    }
+
+    // Токены живут только до конца строки, а дерево может остаться в кэше,
+    // поэтому у дерева своя арена, а поток токенов берётся из строковой
+    if (line_arena == NULL && (line_arena = arena_create()) == NULL) {
+        return NULL;
+    }
+    token_stream_t *ts = tokenize(input, line_arena);
+    if (ts == NULL) {
+        return NULL;
+    }
+
+    arena_t *arena = arena_create();
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    command_list_t *list = arena_calloc(arena, sizeof(command_list_t));
+    and_or_t *and_or = NULL;        // Текущая связка
+    pipeline_t *pipeline = NULL;    // Текущий конвейер
+    int connector = 0;              // Связка перед текущим конвейером
+    int expect_command = 0;         // После | && || команда обязательна
+    int stage_start = 0;
+    int failed = (list == NULL);
+
+    for (int i = 0; i <= ts->count && !failed; i++) {
+        int at_end = (i == ts->count);
+        token_kind_t kind = at_end ? TOK_SEMI : ts->tokens[i].kind;
+
+        // Слова и перенаправления входят в текущую простую команду
+        if (!at_end && (kind == TOK_WORD || is_redirection_kind(kind) || kind == TOK_HEREDOC)) {
             continue;
         }
-        
-        int tokens_to_remove = 0;
-        char *filename = NULL;
-        
-        // Проверяем на перенаправления
-        if (strcmp(words[i], ">") == 0) {
-            // Обычное перенаправление вывода
-            if (i + 1 >= *word_num) {
-                fprintf(stderr, "Error: expected filename after '>'\n");
-                i++;
-                continue;
-            }
-            
-            // Проверяем, что следующий токен не является специальным символом
-            if (is_redirection_char(words[i+1]) || is_command_separator(words[i+1]) || 
-                strcmp(words[i+1], "|") == 0 || strcmp(words[i+1], "&") == 0) {
-                fprintf(stderr, "Error: filename cannot be special character '%s'\n", words[i+1]);
-                i++;
-                continue;
-            }
-            
-            if (cmd->output_file != NULL) {
-                fprintf(stderr, "Warning: multiple output redirections, using last one\n");
-                free(cmd->output_file);
-            }
-            
-            filename = strdup(words[i + 1]);
-            if (filename == NULL) {
-                perror("strdup");
-                i++;
-                continue;
-            }
-                        
-            cmd->output_file = filename;
-            cmd->append_output = 0;
-            tokens_to_remove = 2;
-            
-        } else if (strcmp(words[i], ">>") == 0) {
-            // Перенаправление вывода с дополнением
-            if (i + 1 >= *word_num) {
-                fprintf(stderr, "Error: expected filename after '>>'\n");
-                i++;
-                continue;
-            }
-            
-            // Проверяем, что следующий токен не является специальным символом
-            if (is_redirection_char(words[i+1]) || is_command_separator(words[i+1]) || 
-                strcmp(words[i+1], "|") == 0 || strcmp(words[i+1], "&") == 0) {
-                fprintf(stderr, "Error: filename cannot be special character '%s'\n", words[i+1]);
-                i++;
-                continue;
-            }
-            
-            if (cmd->output_file != NULL) {
-                fprintf(stderr, "Warning: multiple output redirections, using last one\n");
-                free(cmd->output_file);
-            }
-            
-            filename = strdup(words[i + 1]);
-            if (filename == NULL) {
-                perror("strdup");
-                i++;
-                continue;
-            }
-            
-            cmd->output_file = filename;
-            cmd->append_output = 1;
-            tokens_to_remove = 2;
-            
-        } else if (strcmp(words[i], "<") == 0) {
-            // Перенаправление ввода
-            if (i + 1 >= *word_num) {
-                fprintf(stderr, "Error: expected filename after '<'\n");
-                i++;
-                continue;
-            }
-            
-            // Проверяем, что следующий токен не является специальным символом
-            if (is_redirection_char(words[i+1]) || is_command_separator(words[i+1]) || 
-                strcmp(words[i+1], "|") == 0 || strcmp(words[i+1], "&") == 0) {
-                fprintf(stderr, "Error: filename cannot be special character '%s'\n", words[i+1]);
-                i++;
-                continue;
-            }
-            
-            if (cmd->input_file != NULL) {
-                fprintf(stderr, "Warning: multiple input redirections, using last one\n");
-                free(cmd->input_file);
-            }
-            
-            filename = strdup(words[i + 1]);
-            if (filename == NULL) {
-                perror("strdup");
-                i++;
-                continue;
-            }
-            
-            cmd->input_file = filename;
-            tokens_to_remove = 2;
-            
-        } else if (strcmp(words[i], "2>") == 0) {
-            // Перенаправление stderr
-            if (i + 1 >= *word_num) {
-                fprintf(stderr, "Error: expected filename after '2>'\n");
-                i++;
-                continue;
-            }
-            
-            // Проверяем, что следующий токен не является специальным символом
-            if (is_redirection_char(words[i+1]) || is_command_separator(words[i+1]) || 
-                strcmp(words[i+1], "|") == 0 || strcmp(words[i+1], "&") == 0) {
-                fprintf(stderr, "Error: filename cannot be special character '%s'\n", words[i+1]);
-                i++;
-                continue;
-            }
-            
-            if (cmd->error_file != NULL) {
-                fprintf(stderr, "Warning: multiple stderr redirections, using last one\n");
-                free(cmd->error_file);
+
+        if (i > stage_start) {
+            command_t *cmd = build_simple_command(ts, stage_start, i, arena);
+            if (pipeline == NULL) {
+                pipeline = arena_calloc(arena, sizeof(pipeline_t));
             }
-            
-            filename = strdup(words[i + 1]);
-            if (filename == NULL) {
-                perror("strdup");
-                i++;
-                continue;
+            if (cmd == NULL || pipeline == NULL || append_stage(arena, pipeline, cmd) < 0) {
+                failed = 1;
+                break;
             }
-            
-            cmd->error_file = filename;
-            cmd->append_error = 0;
-            tokens_to_remove = 2;
-            
-        } else if (strcmp(words[i], "2>>") == 0) {
-            // Перенаправление stderr с дополнением
-            if (i + 1 >= *word_num) {
-                fprintf(stderr, "Error: expected filename after '2>>'\n");
-                i++;
-                continue;
+            expect_command = 0;
+        } else if (expect_command || !at_end) {
+            // Оператор без команды перед ним: "| ls", "ls && ;", "ls |"
+            if (at_end) {
+                fprintf(stderr, "Syntax error near unexpected token 'newline'\n");
+            } else {
+                fprintf(stderr, "Syntax error near unexpected token '%.*s'\n",
+                        (int)ts->tokens[i].length, ts->text + ts->tokens[i].offset);
             }
-            
-            // Проверяем, что следующий токен не является специальным символом
-            if (is_redirection_char(words[i+1]) || is_command_separator(words[i+1]) || 
-                strcmp(words[i+1], "|") == 0 || strcmp(words[i+1], "&") == 0) {
-                fprintf(stderr, "Error: filename cannot be special character '%s'\n", words[i+1]);
-                i++;
-                continue;
+            failed = 1;
+            break;
+        }
+
+        stage_start = i + 1;
+
+        if (kind == TOK_PIPE) {
+            expect_command = 1;
+            continue;
+        }
+
+        // && || ; & и конец строки завершают конвейер
+        if (pipeline != NULL) {
+            if (and_or == NULL) {
+                and_or = arena_calloc(arena, sizeof(and_or_t));
             }
-            
-            if (cmd->error_file != NULL) {
-                fprintf(stderr, "Warning: multiple stderr redirections, using last one\n");
-                free(cmd->error_file);
+            if (and_or == NULL || append_pipeline(arena, and_or, pipeline, connector) < 0) {
+                failed = 1;
+                break;
             }
-            
-            filename = strdup(words[i + 1]);
-            if (filename == NULL) {
-                perror("strdup");
-                i++;
-                continue;
+            pipeline = NULL;
+        }
+
+        if (kind == TOK_AND_IF || kind == TOK_OR_IF) {
+            connector = get_separator_type(kind);
+            expect_command = 1;
+            continue;
+        }
+
+        // ; & и конец строки завершают связку
+        if (and_or != NULL) {
+            and_or->fonius = (kind == TOK_AMP);
+
+            // Одиночная команда в фоне запускается без дочернего shell (launch_background)
+            if (and_or->fonius && and_or->count == 1 && and_or->pipelines[0]->stage_count == 1) {
+                and_or->pipelines[0]->stages[0]->fonius = 1;
             }
-            
-            cmd->error_file = filename;
-            cmd->append_error = 1;
-            tokens_to_remove = 2;
-            
-        } else if (strcmp(words[i], "2>&1") == 0) {
-            // Объединение stderr с stdout
-            if (cmd->merge_output) {
-                fprintf(stderr, "Warning: multiple output merges\n");
+
+            if (append_and_or(arena, list, and_or) < 0) {
+                failed = 1;
+                break;
             }
-            
-            cmd->merge_output = 1;
-            tokens_to_remove = 1;
-        }
-        
-        // Удаляем обработанные токены
-        if (tokens_to_remove > 0) {
-            remove_words(words, word_num, i, tokens_to_remove);
-            // Не увеличиваем i, так как массив сдвинулся
-        } else {
-            i++;
+            and_or = NULL;
         }
+        connector = 0;
+    }
+
+    if (failed || list->count == 0) {
+        arena_destroy(arena);
+        return NULL;
     }
+
+    list->arena = arena;
+    list->refcount = 1;
+    return list;
 }
 
-// Функция освобождения памяти
-void free_command(command_t *cmd) {
-    if (cmd == NULL) return;
+// Освобождение всего дерева строки: все узлы лежат в арене дерева
+void free_command_list(command_list_t *list) {
+    if (list == NULL) return;
 
-    // Освобождаем токены
-    for (int i = 0; i < cmd->word_num; i++) {
-        free(cmd->words[i]);
+    arena_destroy(list->arena);
+}
+
+// Отладочная печать одной операции перенаправления
+static void print_redirect(const redirect_t *r) {
+    switch (r->op) {
+        case REDIR_OPEN:
+            printf("open %s -> fd %d (%s)\n", r->path, r->fd,
+                   (r->flags & O_APPEND) ? "append" :
+                   (r->flags & O_TRUNC) ? "trunc" : "read");
+            break;
+        case REDIR_DUP:
+            printf("dup fd %d -> fd %d\n", r->src_fd, r->fd);
+            break;
+        case REDIR_CLOSE:
+            printf("close fd %d\n", r->fd);
+            break;
+    }
+}
+
+// Отладка дерева команд
+void print_command_list(const command_list_t *list) {
+    if (list == NULL) {
+        printf("Command list: NULL\n");
+        return;
     }
-    free(cmd->words);
     
-    // Освобождаем имена файлов
-    free(cmd->input_file);
-    free(cmd->output_file);
-    free(cmd->error_file);
-
-    // Освобождаем конвейер (если есть)
-    if (cmd->pipeline != NULL) {
-        for (int i = 0; i < cmd->pipeline_count; i++) {
-            for (int j = 0; cmd->pipeline[i][j] != NULL; j++) {
-                free(cmd->pipeline[i][j]);
+    printf("Command list (%d and-or lists):\n", list->count);
+    for (int i = 0; i < list->count; i++) {
+        const and_or_t *and_or = list->lists[i];
+        printf("  List %d%s:\n", i + 1, and_or->fonius ? " (fonius)" : "");
+
+        for (int j = 0; j < and_or->count; j++) {
+            const pipeline_t *pipeline = and_or->pipelines[j];
+            if (j > 0) {
+                printf("    Separator: %s\n", and_or->connectors[j] == 1 ? "&&" : "||");
+            }
+
+            for (int k = 0; k < pipeline->stage_count; k++) {
+                const command_t *cmd = pipeline->stages[k];
+                printf("    %s", k > 0 ? "| " : "");
+                for (int w = 0; w < cmd->word_num; w++) {
+                    printf("[%s] ", cmd->words[w]);
+                }
+                printf("\n");
+
+                // Выводим информацию о перенаправлениях
+                for (int r = 0; r < cmd->redirect_count; r++) {
+                    printf("      ");
+                    print_redirect(&cmd->redirects[r]);
+                }
             }
-            free(cmd->pipeline[i]);
         }
-        free(cmd->pipeline);
     }
-    
-    free(cmd);
 }
 
 // Дополнительная функция для отладки
@@ -796,11 +582,9 @@ void print_command(const command_t *cmd) {
     printf("\n");
     
     printf("fonius: %s\n", cmd->fonius ? "yes" : "no");
-    printf("Input file: %s\n", cmd->input_file ? cmd->input_file : "NULL");
-    printf("Output file: %s\n", cmd->output_file ? cmd->output_file : "NULL");
-    printf("Error file: %s\n", cmd->error_file ? cmd->error_file : "NULL");  
-    printf("Append output: %s\n", cmd->append_output ? "yes" : "no");
-    printf("Append error: %s\n", cmd->append_error ? "yes" : "no");          
-    printf("Merge output: %s\n", cmd->merge_output ? "yes" : "no");          
-    printf("Pipeline count: %d\n", cmd->pipeline_count);
+    printf("Redirections: %d\n", cmd->redirect_count);
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        printf("  ");
+        print_redirect(&cmd->redirects[i]);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Кэш разобранных строк: повторно введённая строка (из истории или
+// в цикле скрипта) не разбирается заново. Деревья неизменяемы и
+// раздаются исполнителю со счётчиком ссылок.
+
+#define PARSE_CACHE_SIZE 64
+#define PARSE_CACHE_BUCKETS 128   // Степень двойки
+
+typedef struct {
+    uint64_t hash;
+    char *line;
+    command_list_t *tree;
+    int bucket_next;    // Следующая запись в той же корзине (-1 - конец)
+    int lru_prev;       // Более свежая запись (-1 - голова)
+    int lru_next;       // Более старая запись (-1 - хвост)
+} cache_entry_t;
+
+static cache_entry_t entries[PARSE_CACHE_SIZE];
+static int buckets[PARSE_CACHE_BUCKETS];
+static int entry_count = 0;
+static int lru_head = -1;
+static int lru_tail = -1;
+static int initialized = 0;
+static parse_cache_stats_t stats;
+
+static uint64_t hash_line(const char *line) {
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)line; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void cache_init(void) {
+    for (int i = 0; i < PARSE_CACHE_BUCKETS; i++) {
+        buckets[i] = -1;
+    }
+    initialized = 1;
+}
+
+static void lru_unlink(int index) {
+    cache_entry_t *e = &entries[index];
+    if (e->lru_prev != -1) entries[e->lru_prev].lru_next = e->lru_next;
+    else lru_head = e->lru_next;
+    if (e->lru_next != -1) entries[e->lru_next].lru_prev = e->lru_prev;
+    else lru_tail = e->lru_prev;
+}
+
+static void lru_push_front(int index) {
+    entries[index].lru_prev = -1;
+    entries[index].lru_next = lru_head;
+    if (lru_head != -1) entries[lru_head].lru_prev = index;
+    lru_head = index;
+    if (lru_tail == -1) lru_tail = index;
+}
+
+static void bucket_unlink(int index) {
+    int *link = &buckets[entries[index].hash & (PARSE_CACHE_BUCKETS - 1)];
+    while (*link != -1) {
+        if (*link == index) {
+            *link = entries[index].bucket_next;
+            return;
+        }
+        link = &entries[*link].bucket_next;
+    }
+}
+
+// Вытеснение самой старой записи; возвращает освободившийся слот
+static int evict_oldest(void) {
+    int index = lru_tail;
+    lru_unlink(index);
+    bucket_unlink(index);
+    release_command_list(entries[index].tree);
+    stats.evictions++;
+    return index;
+}
+
+command_list_t *parse_line_cached(const char *input) {
+    if (input == NULL) {
+        return NULL;
+    }
+    if (!initialized) {
+        cache_init();
+    }
+
+    uint64_t hash = hash_line(input);
+    int bucket = hash & (PARSE_CACHE_BUCKETS - 1);
+
+    for (int i = buckets[bucket]; i != -1; i = entries[i].bucket_next) {
+        if (entries[i].hash == hash && strcmp(entries[i].line, input) == 0) {
+            stats.hits++;
+            lru_unlink(i);
+            lru_push_front(i);
+            entries[i].tree->refcount++;
+            return entries[i].tree;
+        }
+    }
+
+    stats.misses++;
+
+    command_list_t *tree = parse_line(input);
+    if (tree == NULL) {
+        // Синтаксические ошибки не кэшируем, чтобы сообщение выводилось каждый раз
+        return NULL;
+    }
+
+    // Ключ лежит в арене дерева и освобождается вместе с ним
+    char *line = arena_strdup(tree->arena, input);
+    if (line == NULL) {
+        // Без кэша дерево всё равно пригодно
+        return tree;
+    }
+
+    int index = entry_count < PARSE_CACHE_SIZE ? entry_count++ : evict_oldest();
+    entries[index].hash = hash;
+    entries[index].line = line;
+    entries[index].tree = tree;
+    entries[index].bucket_next = buckets[bucket];
+    buckets[bucket] = index;
+    lru_push_front(index);
+
+    // Одна ссылка у кэша, одна у вызывающего
+    tree->refcount++;
+    return tree;
+}
+
+void release_command_list(command_list_t *list) {
+    if (list == NULL) return;
+
+    if (--list->refcount == 0) {
+        free_command_list(list);
+    }
+}
+
+void parse_cache_clear(void) {
+    for (int i = lru_head; i != -1; i = entries[i].lru_next) {
+        release_command_list(entries[i].tree);
+    }
+    for (int i = 0; i < PARSE_CACHE_BUCKETS; i++) {
+        buckets[i] = -1;
+    }
+    entry_count = 0;
+    lru_head = -1;
+    lru_tail = -1;
+    initialized = 1;
+}
+
+void get_parse_cache_stats(parse_cache_stats_t *out) {
+    *out = stats;
+    out->entries = entry_count;
+    out->capacity = PARSE_CACHE_SIZE;
+}
@@ -0,0 +1,317 @@
+#define _GNU_SOURCE
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+// Таблица путей команд (как hash в bash): имя команды -> найденный
+// путь. Промахи тоже запоминаются, чтобы опечатка не стоила обхода
+// всего PATH заново: на WSL каждый каталог /mnt/c/... - это запросы 9p.
+//
+// При промахе сначала спрашивается общий индекс (exeindex.c), и только
+// если он не помог, обходится PATH.
+//
+// Таблица сбрасывается целиком, когда меняется PATH (setpath, addpath,
+// resetpath) или inotify сообщает об изменении одного из каталогов PATH.
+// Без inotify отрицательные записи живут не дольше PATH_HASH_NEG_TTL -
+// как и тогда, когда хотя бы за одним каталогом следить не удалось
+// (например, его ещё нет): команда может появиться именно там.
+
+#define PATH_HASH_BUCKETS 256        // Степень двойки
+#define PATH_HASH_MAX_ENTRIES 4096   // Больше - таблица сбрасывается
+#define PATH_HASH_NEG_TTL 5          // Секунд, если нет inotify
+
+typedef struct path_entry {
+    struct path_entry *next;
+    uint64_t hash;
+    char *name;
+    char *path;             // NULL - команды нет ни в одном каталоге
+    time_t stamp;           // Когда найдена (для отрицательных записей)
+    unsigned long hits;
+} path_entry_t;
+
+static path_entry_t *buckets[PATH_HASH_BUCKETS];
+static arena_t *table_arena = NULL;   // Записи и строки таблицы
+static int inotify_fd = -1;           // Наблюдение за каталогами PATH
+static int watches_ready = 0;
+static int watches_complete = 0;      // Наблюдаются все каталоги PATH
+static int allocated = 0;             // Записей в арене, включая забытые
+static path_hash_stats_t stats;
+
+// Попадания по каталогам PATH (для pathprof). Переживают сброс таблицы:
+// по ним видно, где команды находятся на самом деле.
+#define PATH_DIR_HITS_MAX 256
+
+typedef struct {
+    char *dir;
+    unsigned long hits;
+} dir_hits_t;
+
+static dir_hits_t dir_hits[PATH_DIR_HITS_MAX];
+static int dir_hits_count = 0;
+
+static uint64_t hash_name(const char *name) {
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void stop_watching(void) {
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    watches_ready = 0;
+    watches_complete = 0;
+}
+
+// Наблюдение за каждым каталогом PATH: появление, удаление и смена прав
+// файла в нём делают таблицу устаревшей
+static void start_watching(const char *path_env) {
+    watches_ready = 1;
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        return;
+    }
+
+    int watched = 0, wanted = 0;
+    const char *dir = path_env;
+    while (*dir) {
+        const char *colon = strchr(dir, ':');
+        size_t len = colon ? (size_t)(colon - dir) : strlen(dir);
+
+        if (len > 0 && len < MAX_PATH_LENGTH) {
+            char dir_path[MAX_PATH_LENGTH];
+            memcpy(dir_path, dir, len);
+            dir_path[len] = '\0';
+            wanted++;
+            if (inotify_add_watch(inotify_fd, dir_path,
+                                  IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                  IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) >= 0) {
+                watched++;
+            }
+        }
+
+        if (colon == NULL) break;
+        dir = colon + 1;
+    }
+
+    if (watched == 0) {
+        stop_watching();
+        watches_ready = 1;
+        return;
+    }
+    watches_complete = watched == wanted;
+}
+
+// Были ли изменения в каталогах PATH с прошлой проверки
+static int directories_changed(void) {
+    if (inotify_fd < 0) {
+        return 0;
+    }
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    while (read(inotify_fd, buf, sizeof(buf)) > 0) {
+        changed = 1;
+    }
+    return changed;
+}
+
+void path_hash_clear(void) {
+    for (int i = 0; i < PATH_HASH_BUCKETS; i++) {
+        buckets[i] = NULL;
+    }
+    if (table_arena != NULL) {
+        arena_reset(table_arena);
+    }
+    stats.entries = 0;
+    allocated = 0;
+    stats.invalidations++;
+    stop_watching();
+    exe_index_recheck();
+}
+
+static dir_hits_t *find_dir_hits(const char *dir, size_t len) {
+    for (int i = 0; i < dir_hits_count; i++) {
+        if (strncmp(dir_hits[i].dir, dir, len) == 0 && dir_hits[i].dir[len] == '\0') {
+            return &dir_hits[i];
+        }
+    }
+    return NULL;
+}
+
+static void record_dir_hit(const char *dir, size_t len) {
+    dir_hits_t *d = find_dir_hits(dir, len);
+    if (d == NULL) {
+        if (dir_hits_count == PATH_DIR_HITS_MAX) {
+            return;
+        }
+        char *copy = strndup(dir, len);
+        if (copy == NULL) {
+            return;
+        }
+        d = &dir_hits[dir_hits_count++];
+        d->dir = copy;
+        d->hits = 0;
+    }
+    d->hits++;
+}
+
+// Сколько команд было найдено в каталоге PATH
+unsigned long path_dir_hits(const char *dir) {
+    dir_hits_t *d = find_dir_hits(dir, strlen(dir));
+    return d != NULL ? d->hits : 0;
+}
+
+// Обход PATH без копирования строки. Результат - во временной арене строки.
+static char *search_path(const char *command, const char *path_env) {
+    size_t cmd_len = strlen(command);
+    const char *dir = path_env;
+
+    while (*dir) {
+        const char *colon = strchr(dir, ':');
+        size_t dir_len = colon ? (size_t)(colon - dir) : strlen(dir);
+
+        // Проверка длины пути
+        if (dir_len > 0 && dir_len + cmd_len + 2 <= MAX_PATH_LENGTH) {
+            char full_path[MAX_PATH_LENGTH];
+            memcpy(full_path, dir, dir_len);
+            full_path[dir_len] = '/';
+            memcpy(full_path + dir_len + 1, command, cmd_len + 1);
+
+            stats.dir_probes++;
+            if (access(full_path, X_OK) == 0) {
+                record_dir_hit(dir, dir_len);
+                return arena_strdup(line_arena, full_path);
+            }
+        }
+
+        if (colon == NULL) break;
+        dir = colon + 1;
+    }
+    return NULL;
+}
+
+static path_entry_t *find_entry(const char *name, uint64_t hash) {
+    for (path_entry_t *e = buckets[hash & (PATH_HASH_BUCKETS - 1)]; e != NULL; e = e->next) {
+        if (e->hash == hash && strcmp(e->name, name) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void remember(const char *name, uint64_t hash, const char *path) {
+    if (table_arena == NULL && (table_arena = arena_create()) == NULL) {
+        return;
+    }
+    if (allocated >= PATH_HASH_MAX_ENTRIES) {
+        path_hash_clear();
+    }
+
+    path_entry_t *e = arena_alloc(table_arena, sizeof(path_entry_t));
+    if (e == NULL) {
+        return;
+    }
+    e->name = arena_strdup(table_arena, name);
+    e->path = path != NULL ? arena_strdup(table_arena, path) : NULL;
+    if (e->name == NULL || (path != NULL && e->path == NULL)) {
+        return;
+    }
+    e->hash = hash;
+    e->stamp = time(NULL);
+    e->hits = 0;
+
+    int bucket = hash & (PATH_HASH_BUCKETS - 1);
+    e->next = buckets[bucket];
+    buckets[bucket] = e;
+    stats.entries++;
+    allocated++;
+}
+
+// Поиск команды (имя без '/') через таблицу. Возвращает путь во
+// временной арене строки или NULL, если команды нет.
+char *path_hash_lookup(const char *command) {
+    const char *path_env = getenv("PATH");
+    if (path_env == NULL) {
+        return NULL;
+    }
+
+    if (!watches_ready) {
+        start_watching(path_env);
+    } else if (directories_changed()) {
+        path_hash_clear();
+        start_watching(path_env);
+    }
+
+    uint64_t hash = hash_name(command);
+    path_entry_t *e = find_entry(command, hash);
+
+    if (e != NULL && e->path == NULL && (inotify_fd < 0 || !watches_complete) &&
+        time(NULL) - e->stamp > PATH_HASH_NEG_TTL) {
+        // Без inotify за всеми каталогами отрицательной записи нельзя
+        // доверять долго
+        path_hash_forget(command);
+        e = NULL;
+    }
+
+    if (e != NULL) {
+        e->hits++;
+        if (e->path == NULL) {
+            stats.negative_hits++;
+            return NULL;
+        }
+        stats.hits++;
+        return arena_strdup(line_arena, e->path);
+    }
+
+    // Общий индекс исполняемых файлов отвечает без обхода каталогов
+    stats.misses++;
+    char *found = NULL;
+    int indexed = exe_index_lookup(command, path_env, &found);
+    if (indexed < 0) {
+        found = search_path(command, path_env);
+    } else if (indexed > 0) {
+        record_dir_hit(found, strlen(found) - strlen(command) - 1);
+    }
+    remember(command, hash, found);
+    return found;
+}
+
+// Удаление одной записи (hash -d): путь устарел, например команду удалили
+int path_hash_forget(const char *command) {
+    uint64_t hash = hash_name(command);
+    path_entry_t **link = &buckets[hash & (PATH_HASH_BUCKETS - 1)];
+
+    for (; *link != NULL; link = &(*link)->next) {
+        if ((*link)->hash == hash && strcmp((*link)->name, command) == 0) {
+            *link = (*link)->next;
+            stats.entries--;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Обход записей таблицы (для встроенной команды hash)
+void path_hash_foreach(void (*fn)(const char *name, const char *path, unsigned long hits)) {
+    for (int i = 0; i < PATH_HASH_BUCKETS; i++) {
+        for (path_entry_t *e = buckets[i]; e != NULL; e = e->next) {
+            fn(e->name, e->path, e->hits);
+        }
+    }
+}
+
+void get_path_hash_stats(path_hash_stats_t *out) {
+    *out = stats;
+    out->watching = inotify_fd < 0 ? 0 : watches_complete ? 1 : 2;
+}
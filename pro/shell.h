@@ -12,29 +12,156 @@
 #include <signal.h>
 #include <errno.h>
 #include <ctype.h>
+#include "loadable.h"
 
 #define MAX_INPUT_LENGTH 4096
-#define MAX_WORDS 100
 #define MAX_PATH_LENGTH 1024
 #define MAX_HISTORY_SIZE 100
 #define MAX_HISTORY_LENGTH 256
 #define HISTORY_FILE ".myshell_history"
 
+// Арена: память выделяется из крупных блоков и освобождается целиком
+typedef struct arena arena_t;
+
+// Счётчики арен
+typedef struct {
+    unsigned long bytes_allocated;   // Выдано за всё время
+    unsigned long blocks_mapped;     // Отображено блоков сейчас
+    unsigned long bytes_mapped;
+    unsigned long trims;             // Блоков отдано ОС через madvise
+    int pool_blocks;                 // Свободных блоков в пуле
+} arena_stats_t;
+
+// Вид токена
+typedef enum {
+    TOK_WORD,               // Слово (в том числе взятое в кавычки)
+    TOK_PIPE,               // |
+    TOK_AND_IF,             // &&
+    TOK_OR_IF,              // ||
+    TOK_SEMI,               // ;
+    TOK_AMP,                // &
+    TOK_REDIR_IN,           // <
+    TOK_REDIR_OUT,          // >
+    TOK_REDIR_APPEND,       // >>
+    TOK_REDIR_ERR,          // 2>
+    TOK_REDIR_ERR_APPEND,   // 2>>
+    TOK_REDIR_MERGE,        // 2>&1
+    TOK_HEREDOC             // <<
+} token_kind_t;
+
+// Токен - срез в собственной копии строки
+typedef struct {
+    size_t offset;
+    size_t length;
+    token_kind_t kind;
+} token_t;
+
+// Поток токенов одной строки
+typedef struct {
+    char *text;          // Копия строки со снятыми кавычками
+    token_t *tokens;     // Растущий массив токенов
+    int count;
+    int capacity;
+    arena_t *arena;      // Арена, из которой берётся память потока
+} token_stream_t;
+
+// Операция перенаправления над дескриптором
+typedef enum {
+    REDIR_OPEN,          // Открыть path с flags и поставить на fd
+    REDIR_DUP,           // Скопировать src_fd в fd (2>&1)
+    REDIR_CLOSE          // Закрыть fd
+} redirect_op_t;
+
+typedef struct {
+    redirect_op_t op;
+    int fd;              // Целевой дескриптор
+    int src_fd;          // Источник для REDIR_DUP
+    int flags;           // Флаги open для REDIR_OPEN
+    const char *path;    // Имя файла (лежит в арене дерева)
+} redirect_t;
+
 // Структура для хранения разобранной команды
 typedef struct {
-    char **words;
+    char **words;        // Строки слов лежат одним блоком в арене дерева
     int word_num;
-    int fonius;      // Фоновый режим
-    char *input_file;    // Файл для ввода
-    char *output_file;   // Файл для вывода stdout
-    char *error_file;    // НОВОЕ: Файл для вывода stderr
-    int append_output;   // Добавление в файл для stdout
-    int append_error;    // НОВОЕ: Добавление в файл для stderr
-    int merge_output;    // НОВОЕ: Объединение stdout и stderr (2>&1)
-    char ***pipeline;    // Команды в конвейере
-    int pipeline_count;  // Количество команд в конвейере
+    int fonius;          // Фоновый режим
+    redirect_t *redirects;  // Перенаправления в порядке записи
+    int redirect_count;
 } command_t;
 
+// Конвейер: простые команды, соединённые |
+typedef struct {
+    command_t **stages;      // Команды конвейера
+    int stage_count;         // Количество команд
+    int capacity;
+    int force_success;       // Оптимизатор отбросил | cat: статус конвейера 0
+} pipeline_t;
+
+// Связка конвейеров через && и ||
+typedef struct {
+    pipeline_t **pipelines;  // Конвейеры связки
+    int *connectors;         // Связка перед конвейером (1 - &&, 2 - ||; у первого 0)
+    int count;               // Количество конвейеров
+    int capacity;
+    int fonius;              // Связка завершена символом &
+} and_or_t;
+
+// Разобранная строка: связки, разделённые ; или &
+typedef struct {
+    and_or_t **lists;
+    int count;
+    int capacity;
+    int refcount;            // Ссылки исполнителя и кэша разбора
+    arena_t *arena;          // Арена, в которой лежат все узлы дерева
+} command_list_t;
+
+// Счётчики кэша разобранных строк
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    int entries;
+    int capacity;
+} parse_cache_stats_t;
+
+// Способ запуска внешней команды
+typedef enum {
+    LAUNCH_SPAWN,           // posix_spawn (clone с CLONE_VFORK)
+    LAUNCH_FORK,            // fork + execv
+    LAUNCH_BACKENDS
+} launch_backend_t;
+
+// Счётчики запусков внешних команд
+typedef struct {
+    unsigned long launches[LAUNCH_BACKENDS];
+    unsigned long long total_ns[LAUNCH_BACKENDS];  // Время в родителе до возврата запуска
+    unsigned long waits[LAUNCH_BACKENDS];          // Дождались команд переднего плана
+    unsigned long long wait_ns[LAUNCH_BACKENDS];   // От начала запуска до завершения
+    unsigned long fallbacks;     // Повторы через fork после ошибки posix_spawn
+    unsigned long failures;      // Запуски, не удавшиеся совсем
+} launch_stats_t;
+
+// Счётчики таблицы путей команд
+typedef struct {
+    unsigned long hits;          // Путь взят из таблицы
+    unsigned long negative_hits; // Отсутствие команды взято из таблицы
+    unsigned long misses;        // Понадобился обход PATH
+    unsigned long dir_probes;    // Вызовов access() при обходах
+    unsigned long invalidations; // Сбросов таблицы
+    int entries;
+    int watching;                // inotify: 0 - нет, 1 - все каталоги PATH, 2 - часть
+} path_hash_stats_t;
+
+// Счётчики общего индекса исполняемых файлов
+typedef struct {
+    unsigned long hits;          // Команда найдена по индексу
+    unsigned long negative_hits; // Свежий индекс знает, что команды нет
+    unsigned long rebuilds;      // Индекс перестроен этим shell
+    int mapped;
+    int entries;
+    int dirs;
+} exe_index_stats_t;
+
 typedef struct {
     char **commands;        // Массив команд
     int count;              // Текущее количество команд
@@ -42,24 +169,167 @@ typedef struct {
     int current_index;      // Текущий индекс для навигации
 } history_t;
 
-typedef struct {
-    command_t **commands;    // Массив команд
-    int command_count;       // Количество команд в последовательности
-    int *separators;         // Разделители между командами (0 - ;, 1 - &&, 2 - ||)
-} command_sequence_t;
+// Классы символов лексера (битовые флаги в char_class)
+#define CH_DELIM     0x01    // Пробельный разделитель
+#define CH_QUOTE     0x02    // " или '
+#define CH_ESCAPE    0x04    // Обратный слеш
+#define CH_OPERATOR  0x08    // Начало оператора: > < | & ;
+#define CH_SPECIAL   0x10    // Специальный символ (is_special_char)
+
+extern const unsigned char char_class[256];
+
+// Арены
+arena_t *arena_create(void);
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_calloc(arena_t *arena, size_t size);
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strndup(arena_t *arena, const char *s, size_t n);
+char *arena_strdup(arena_t *arena, const char *s);
+void arena_reset(arena_t *arena);
+void arena_destroy(arena_t *arena);
+void arena_trim(void);
+void get_arena_stats(arena_stats_t *out);
+
+// Временная арена строки: сбрасывается после исполнения каждой строки
+extern arena_t *line_arena;
+
+// Функции лексера
+size_t scan_word_run(const char *p, const char *end);
+const char *scan_word_run_name(void);
+token_stream_t *tokenize(const char *input, arena_t *arena);
+char **materialize_words(const token_stream_t *ts, int first, int count, arena_t *arena);
 
 // Функции парсера
-command_t *parse_input(const char *input);
-command_sequence_t *parse_input_with_separators(const char *input);
-void free_command(command_t *cmd);
-void free_command_sequence(command_sequence_t *seq);
+command_list_t *parse_line(const char *input);
+void free_command_list(command_list_t *list);
+
+// Кэш разобранных строк
+command_list_t *parse_line_cached(const char *input);
+void release_command_list(command_list_t *list);
+void parse_cache_clear(void);
+void get_parse_cache_stats(parse_cache_stats_t *out);
 
 // Функции исполнителя
 int execute_command(command_t *cmd);
-int execute_command_sequence(command_sequence_t *seq);
+int execute_pipeline(pipeline_t *pipeline);
+pipeline_t *optimize_pipeline(pipeline_t *pipeline);
+int execute_and_or(and_or_t *and_or);
+int execute_command_list(command_list_t *list);
 int execute_bash_cmd(char **args);
-int execute_fonius(command_t *cmd);
-int execute_pipeline(command_t *cmd);
+int is_builtin(const char *name);
+int apply_redirections(command_t *cmd);
+
+// Реестр встроенных команд (builtins.def)
+#define BUILTIN_NOFORK   0x01    // Может выполняться в процессе shell
+#define BUILTIN_STATE    0x02    // Меняет состояние shell
+#define BUILTIN_THREAD   0x04    // Может быть стадией конвейера в потоке shell
+#define BUILTIN_DISABLED 0x80    // Выключена командой enable -n
+
+typedef struct {
+    const char *name;
+    int (*func)(char **args);
+    int flags;
+    const shell_loadable_t *loadable;   // Загружена через enable -f
+    void *handle;                       // Дескриптор dlopen
+} builtin_t;
+
+// Хэш имени встроенной команды; затравку подбирает mkbuiltins так,
+// чтобы хэш был совершенным на именах из builtins.def
+static inline unsigned builtin_hash(const char *name, unsigned seed) {
+    unsigned h = seed;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+const builtin_t *find_builtin(const char *name);
+int run_builtin(const builtin_t *builtin, char **args);
+
+// Стандартные потоки встроенной команды. Стадия конвейера с флагом
+// BUILTIN_THREAD выполняется в потоке shell и читает/пишет концы своих
+// pipe'ов, поэтому такие команды выводят только через builtin_out()
+// и читают через builtin_in(). Вне потока это stdout и STDIN_FILENO.
+typedef struct {
+    int in_fd;
+    FILE *out;
+} builtin_io_t;
+
+int run_builtin_thread(const builtin_t *builtin, char **args, const builtin_io_t *io);
+const builtin_t *find_filter(char **words);
+FILE *builtin_out(void);
+int builtin_in(void);
+
+// Запуск внешних команд
+pid_t launch_command(command_t *cmd, const char *full_path, int in_fd, int out_fd, pid_t pgid);
+void launch_waited(pid_t pid);
+void get_launch_stats(launch_stats_t *out);
+void reset_launch_stats(void);
+
+// Таблица путей команд
+char *path_hash_lookup(const char *command);
+int path_hash_forget(const char *command);
+void path_hash_clear(void);
+void path_hash_foreach(void (*fn)(const char *name, const char *path, unsigned long hits));
+void get_path_hash_stats(path_hash_stats_t *out);
+unsigned long path_dir_hits(const char *dir);
+
+// Общий индекс исполняемых файлов PATH
+void exe_index_open(void);
+void exe_index_close(void);
+void exe_index_recheck(void);
+int exe_index_lookup(const char *command, const char *path_env, char **found);
+void get_exe_index_stats(exe_index_stats_t *out);
+
+// Управление заданиями (jobs.c)
+typedef struct job job_t;
+
+extern int job_control;
+extern int in_subshell;
+void jobs_init(void);
+job_t *job_create(const pipeline_t *pipeline);
+job_t *job_create_list(const and_or_t *and_or);
+pid_t job_launch_pgid(const job_t *job);
+int job_add_process(job_t *job, pid_t pid);
+int job_run_foreground(job_t *job, int allow_stop);
+void job_run_background(job_t *job);
+void job_discard(job_t *job);
+int job_should_queue(void);
+void job_enqueue(job_t *job, command_list_t *tree, and_or_t *and_or);
+void jobs_start_queued(void);
+int launch_background(job_t *job, and_or_t *and_or);
+void jobs_enter_subshell(void);
+void jobs_reap(void);
+void jobs_notify(void);
+int jobs_pending(void);
+
+// Цикл событий интерактивного ввода (events.c)
+typedef struct event_source event_source_t;
+
+#define KEY_EOF        (-1)   // Терминал закрыт
+#define KEY_INTERRUPT  (-2)   // Ctrl-C (SIGINT)
+#define KEY_NOTIFY     (-3)   // Есть уведомления о заданиях
+
+int events_init(void);
+int events_active(void);
+int events_columns(void);
+void events_discard_signals(void);
+int events_read_key(int allow_notify);
+event_source_t *events_watch_pid(pid_t pid, void (*ready)(void *arg), void *arg);
+void events_unwatch_pid(event_source_t *source);
+
+// Опции shell (set -o/+o)
+extern int opt_spawn;
+extern int opt_threads;
+extern int opt_filters;
+extern int opt_optimize;
+extern int opt_explain;
+extern int opt_maxjobs;
+extern int opt_maxload;
+extern int opt_minmem;
+int set_option(const char *name, int value);
+int set_option_value(const char *name, size_t name_len, const char *text);
+void print_options(void);
 
 // Встроенные команды
 int from_bash_cd(char **args);
@@ -68,9 +338,33 @@ int from_path(char **args);
 int set_path(char **args); 
 int add_to_path(char **args);
 int reset_path(char **args);
+int show_history(char **args);
+int parse_cache_builtin(char **args);
+int set_builtin(char **args);
+int launch_stat_builtin(char **args);
+int hash_builtin(char **args);
+int path_prof_builtin(char **args);
+int enable_builtin(char **args);
+int builtin_builtin(char **args);
+int echo_builtin(char **args);
+int printf_builtin(char **args);
+int true_builtin(char **args);
+int false_builtin(char **args);
+int pwd_builtin(char **args);
+int test_builtin(char **args);
+int bracket_builtin(char **args);
+int jobs_builtin(char **args);
+int fg_builtin(char **args);
+int bg_builtin(char **args);
+int wait_builtin(char **args);
+int kill_builtin(char **args);
+int parallel_builtin(char **args);
+
+// Кэш stat для test/[ живёт в пределах одной строки
+void stat_cache_invalidate(void);
 
 void print_command(const command_t *cmd);
-void print_command_sequence(const command_sequence_t *seq);
+void print_command_list(const command_list_t *list);
 
 // Утилиты
 char *read_line(void);
@@ -78,8 +372,8 @@ char **split_line(char *line);
 char *get_full_path(const char *command);
 
 // Функции для работы с разделителями команд
-int is_command_separator(const char *str);
-int get_separator_type(const char *sep);
+int get_separator_type(token_kind_t kind);
+int is_redirection_kind(token_kind_t kind);
 
 // Поддержка истории команд
 // Прототипы функций для истории - ДОБАВИТЬ
@@ -94,6 +388,7 @@ void print_history(const history_t *hist);
 // Функции для терминала - ДОБАВИТЬ
 int setup_terminal(void);
 void restore_terminal(void);
+int enter_raw_mode(void);
 void clear_current_line(int current_pos);
 
 // Обновленный прототип read_line - ДОБАВИТЬ
@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <spawn.h>
+#include <time.h>
+
+// Запуск внешних команд. По умолчанию используется posix_spawn: glibc
+// создаёт потомка через clone(CLONE_VM|CLONE_VFORK), не копируя таблицы
+// страниц shell (история, кэш разбора, арены), а перенаправления
+// выражаются действиями над файлами. fork остаётся запасным путём для
+// случаев, когда в потомке нужен произвольный код (встроенные команды
+// в конвейере).
+
+extern char **environ;
+
+static launch_stats_t stats;
+
+// Последний запуск: по нему launch_waited считает полное время команды
+static pid_t last_pid = -1;
+static launch_backend_t last_backend;
+static unsigned long long last_start;
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void account(launch_backend_t backend, unsigned long long start, pid_t pid) {
+    stats.launches[backend]++;
+    stats.total_ns[backend] += now_ns() - start;
+    last_pid = pid;
+    last_backend = backend;
+    last_start = start;
+}
+
+// Подключение конвейера и перенаправления команды как действия
+// posix_spawn, в том же порядке, в каком их выполняет дочерний процесс
+// после fork. Остальные pipe'ы созданы с O_CLOEXEC и закрываются при exec.
+static int build_file_actions(posix_spawn_file_actions_t *actions, const command_t *cmd,
+                              int in_fd, int out_fd) {
+    if (in_fd >= 0) {
+        int err = posix_spawn_file_actions_adddup2(actions, in_fd, STDIN_FILENO);
+        if (err != 0) {
+            return err;
+        }
+    }
+    if (out_fd >= 0) {
+        int err = posix_spawn_file_actions_adddup2(actions, out_fd, STDOUT_FILENO);
+        if (err != 0) {
+            return err;
+        }
+    }
+
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        const redirect_t *r = &cmd->redirects[i];
+        int err = 0;
+
+        switch (r->op) {
+            case REDIR_OPEN:
+                err = posix_spawn_file_actions_addopen(actions, r->fd, r->path, r->flags, 0644);
+                break;
+            case REDIR_DUP:
+                err = posix_spawn_file_actions_adddup2(actions, r->src_fd, r->fd);
+                break;
+            case REDIR_CLOSE:
+                err = posix_spawn_file_actions_addclose(actions, r->fd);
+                break;
+        }
+
+        if (err != 0) {
+            return err;
+        }
+    }
+    return 0;
+}
+
+// Сигналы, которые интерактивный shell игнорирует, а потомок должен
+// получать как обычно
+static void job_signals(sigset_t *set) {
+    sigemptyset(set);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGQUIT);
+    sigaddset(set, SIGTSTP);
+    sigaddset(set, SIGTTIN);
+    sigaddset(set, SIGTTOU);
+}
+
+// Группа процессов и сигналы потомка как атрибуты posix_spawn
+static int build_attributes(posix_spawnattr_t *attr, pid_t pgid) {
+    short flags = 0;
+
+    if (pgid >= 0) {
+        int err = posix_spawnattr_setpgroup(attr, pgid);
+        if (err != 0) {
+            return err;
+        }
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    if (job_control) {
+        sigset_t set;
+        job_signals(&set);
+        int err = posix_spawnattr_setsigdefault(attr, &set);
+        if (err != 0) {
+            return err;
+        }
+        flags |= POSIX_SPAWN_SETSIGDEF;
+    }
+
+    // Shell блокирует сигналы цикла событий (events.c), потомок - нет
+    sigset_t empty;
+    sigemptyset(&empty);
+    int err = posix_spawnattr_setsigmask(attr, &empty);
+    if (err != 0) {
+        return err;
+    }
+    flags |= POSIX_SPAWN_SETSIGMASK;
+    return posix_spawnattr_setflags(attr, flags);
+}
+
+// Закрытие всех унаследованных дескрипторов выше stderr одним вызовом
+static void close_inherited_fds(void) {
+    if (close_range(3, ~0U, 0) == 0) {
+        return;
+    }
+
+    // Ядро без close_range
+    long max_fd = sysconf(_SC_OPEN_MAX);
+    if (max_fd < 0 || max_fd > 65536) {
+        max_fd = 65536;
+    }
+    for (int fd = 3; fd < max_fd; fd++) {
+        close(fd);
+    }
+}
+
+static pid_t launch_fork(command_t *cmd, const char *full_path, int in_fd, int out_fd, pid_t pgid) {
+    unsigned long long start = now_ns();
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    } else if (pid == 0) {
+        // Группа задания и обычная реакция на сигналы терминала
+        if (pgid >= 0) {
+            setpgid(0, pgid);
+        }
+        if (job_control) {
+            sigset_t set;
+            job_signals(&set);
+            for (int sig = 1; sig < NSIG; sig++) {
+                if (sigismember(&set, sig) == 1) {
+                    signal(sig, SIG_DFL);
+                }
+            }
+        }
+        sigset_t empty;
+        sigemptyset(&empty);
+        sigprocmask(SIG_SETMASK, &empty, NULL);
+
+        // Дочерний процесс: подключаем конвейер и закрываем всё лишнее
+        if (in_fd >= 0 && dup2(in_fd, STDIN_FILENO) < 0) {
+            perror("dup2");
+            _exit(1);
+        }
+        if (out_fd >= 0 && dup2(out_fd, STDOUT_FILENO) < 0) {
+            perror("dup2");
+            _exit(1);
+        }
+        if (in_fd >= 0 || out_fd >= 0) {
+            close_inherited_fds();
+        }
+
+        if (apply_redirections(cmd) < 0) {
+            fprintf(stderr, "Error: failed to apply redirections\n");
+            _exit(1);
+        }
+
+        // Стадия из одних перенаправлений или встроенная команда
+        if (cmd->word_num == 0) {
+            _exit(0);
+        }
+        if (full_path == NULL) {
+            // _exit: exit сбросил бы и буфер stdin, вернув позицию
+            // общего с shell дескриптора назад, и shell прочитал бы
+            // часть ввода повторно
+            int builtin_result = execute_bash_cmd(cmd->words);
+            fflush(stdout);
+            fflush(stderr);
+            _exit(builtin_result);
+        }
+
+        execv(full_path, cmd->words);
+
+        // Если execv вернул управление - произошла ошибка. Коды как в
+        // других shell: 127 - файла нет, 126 - его нельзя выполнить.
+        int exec_errno = errno;
+        fprintf(stderr, "%s: %s\n", cmd->words[0], strerror(exec_errno));
+        _exit(exec_errno == ENOENT ? 127 : 126);
+    }
+
+    account(LAUNCH_FORK, start, pid);
+    return pid;
+}
+
+// Запуск команды с её перенаправлениями. in_fd и out_fd - концы
+// pipe'ов конвейера для stdin и stdout (-1 - не подключать). full_path
+// равен NULL для встроенной команды, она выполняется в потомке после
+// fork. pgid - группа процессов задания (job_launch_pgid): -1 - не
+// менять, 0 - новая группа. Возвращает pid потомка или -1 (сообщение
+// об ошибке уже выведено).
+pid_t launch_command(command_t *cmd, const char *full_path, int in_fd, int out_fd, pid_t pgid) {
+    // Внешняя команда может изменить файлы, которые видел test
+    stat_cache_invalidate();
+
+    if (!opt_spawn || full_path == NULL || cmd->word_num == 0) {
+        return launch_fork(cmd, full_path, in_fd, out_fd, pgid);
+    }
+
+    unsigned long long start = now_ns();
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    int err = posix_spawn_file_actions_init(&actions);
+    if (err == 0 && (err = posix_spawnattr_init(&attr)) == 0) {
+        err = build_file_actions(&actions, cmd, in_fd, out_fd);
+        if (err == 0) {
+            err = build_attributes(&attr, pgid);
+        }
+        if (err == 0) {
+            pid_t pid;
+            err = posix_spawn(&pid, full_path, &actions, &attr, cmd->words, environ);
+            if (err == 0) {
+                posix_spawnattr_destroy(&attr);
+                posix_spawn_file_actions_destroy(&actions);
+                account(LAUNCH_SPAWN, start, pid);
+                return pid;
+            }
+        }
+        posix_spawnattr_destroy(&attr);
+        posix_spawn_file_actions_destroy(&actions);
+    } else if (err == 0) {
+        posix_spawn_file_actions_destroy(&actions);
+    }
+
+    // Путь из таблицы устарел: команду удалили после того, как её нашли.
+    // ENOENT может прийти и от перенаправления (> /nonexistent/x), тогда
+    // запись верна: с перенаправлениями она забывается, только если
+    // файла команды действительно нет.
+    if (err == ENOENT && strchr(cmd->words[0], '/') == NULL &&
+        (cmd->redirect_count == 0 || access(full_path, F_OK) != 0)) {
+        path_hash_forget(cmd->words[0]);
+    }
+
+    // posix_spawn не сообщает, какое действие не удалось, и не даёт
+    // статуса. Повторяем через fork: потомок выведет точное сообщение
+    // apply_redirections или execv и завершится с кодом 1, 126 или 127,
+    // как при запуске через fork. Нехватка ресурсов так не лечится.
+    if (err != EAGAIN && err != ENOMEM) {
+        stats.fallbacks++;
+        return launch_fork(cmd, full_path, in_fd, out_fd, pgid);
+    }
+
+    stats.failures++;
+    fprintf(stderr, "%s: %s\n", cmd->words[0], strerror(err));
+    return -1;
+}
+
+// Учёт завершения запущенной команды, собранной через waitpid. Время
+// от начала запуска до завершения сравнимо между бэкендами: fork
+// возвращается в родителя до execv, а posix_spawn - только после него.
+void launch_waited(pid_t pid) {
+    if (pid == last_pid) {
+        stats.waits[last_backend]++;
+        stats.wait_ns[last_backend] += now_ns() - last_start;
+        last_pid = -1;
+    }
+}
+
+void get_launch_stats(launch_stats_t *out) {
+    *out = stats;
+}
+
+void reset_launch_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
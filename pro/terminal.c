@@ -7,9 +7,15 @@
 #include <ctype.h>
 
 static struct termios original_termios;
+static struct termios raw_termios;
+static pid_t terminal_owner;        // Процесс, настроивший терминал
 
-// Восстановление оригинальных настроек терминала
+// Восстановление оригинальных настроек терминала. Дочерний shell
+// фонового задания (exit в связке с &) терминал не трогает.
 void restore_terminal(void) {
+    if (getpid() != terminal_owner) {
+        return;
+    }
     tcsetattr(STDIN_FILENO, TCSANOW, &original_termios);
 }
 
@@ -20,13 +26,13 @@ int setup_terminal(void) {
         return -1;
     }
     
-    struct termios new_termios = original_termios;
-    new_termios.c_lflag &= ~(ICANON | ECHO);  // Отключаем канонический режим и эхо
-    new_termios.c_cc[VMIN] = 1;   // Минимум 1 символ для чтения
-    new_termios.c_cc[VTIME] = 0;  // Без таймаута
+    terminal_owner = getpid();
+    raw_termios = original_termios;
+    raw_termios.c_lflag &= ~(ICANON | ECHO);  // Отключаем канонический режим и эхо
+    raw_termios.c_cc[VMIN] = 1;   // Минимум 1 символ для чтения
+    raw_termios.c_cc[VTIME] = 0;  // Без таймаута
     
-    if (tcsetattr(STDIN_FILENO, TCSANOW, &new_termios) == -1) {
-        perror("tcsetattr");
+    if (enter_raw_mode() == -1) {
         return -1;
     }
     
@@ -35,6 +41,17 @@ int setup_terminal(void) {
     return 0;
 }
 
+// Неканонический режим на время чтения строки. Между строками терминал
+// в исходном режиме: команды переднего плана получают эхо и обычное
+// редактирование строки.
+int enter_raw_mode(void) {
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw_termios) == -1) {
+        perror("tcsetattr");
+        return -1;
+    }
+    return 0;
+}
+
 // Очистка текущей строки в терминале
 void clear_current_line(int current_pos) {
     for (int i = 0; i < current_pos; i++) {